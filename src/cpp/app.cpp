@@ -1,73 +1,255 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "lib/protocol/unix_address.h"
+#include "lib/protocol/wire_protocol.h"
+#include "lib/shm-ring/shm_ring.h"
+
 using namespace std;
 
 // Mutex to prevent interleaved console output from multiple threads
 mutex cout_mutex;
 
+// Opens a connection to the sidecar's AF_UNIX socket (a filesystem path, or
+// an abstract name starting with '@'), or returns -1 on failure
+int connect_to_unix_sidecar(int thread_id, const string& name,
+                            bool seqpacket) {
+  struct sockaddr_un serv_addr;
+  socklen_t addrlen = make_unix_address(name, &serv_addr);
+  if (addrlen == 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id << "] Invalid unix socket name: " << name
+         << endl;
+    return -1;
+  }
+
+  int sock = socket(AF_UNIX, seqpacket ? SOCK_SEQPACKET : SOCK_STREAM, 0);
+  if (sock < 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id << "] Socket creation error" << endl;
+    return -1;
+  }
+
+  if (connect(sock, (struct sockaddr*)&serv_addr, addrlen) < 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id << "] Connection Failed. Retrying..."
+         << endl;
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+// Opens a connection to the sidecar, or returns -1 on failure. Uses the
+// AF_UNIX socket named by SIDECAR_UNIX_SOCKET when set, otherwise TCP.
+int connect_to_sidecar(int thread_id) {
+  const char* unix_socket = getenv("SIDECAR_UNIX_SOCKET");
+  if (unix_socket) {
+    const char* type = getenv("SIDECAR_SOCKET_TYPE");
+    bool seqpacket = type && string(type) == "SEQPACKET";
+    return connect_to_unix_sidecar(thread_id, unix_socket, seqpacket);
+  }
+
+  int sock = 0;
+  struct sockaddr_in serv_addr;
+
+  // 1. Create a TCP socket
+  if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id << "] Socket creation error" << endl;
+    return -1;
+  }
+
+  // 2. Configure the server address (localhost:8080 for sidecar IPC)
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(8080);
+
+  // 3. Convert IPv4 address from text to binary form
+  if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id
+         << "] Invalid address / Address not supported" << endl;
+    close(sock);
+    return -1;
+  }
+
+  // 4. Attempt to connect to the sidecar
+  if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+    lock_guard<mutex> lock(cout_mutex);
+    cerr << "[Thread " << thread_id << "] Connection Failed. Retrying..."
+         << endl;
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+// Number of IDs requested per round trip
+const uint32_t BATCH_SIZE = 5;
+
+// Reads up to len bytes, stopping early only at end of stream or on error.
+// Returns the number of bytes read. Data arrives through `pending` in reads
+// of 64 KiB so that a SOCK_SEQPACKET message is never truncated; anything
+// beyond `len` stays in `pending` for the next call.
+size_t read_full(int sock, string& pending, uint8_t* buf, size_t len) {
+  char chunk[65536];
+  while (pending.size() < len) {
+    int valread = read(sock, chunk, sizeof(chunk));
+    if (valread <= 0) break;
+    pending.append(chunk, valread);
+  }
+
+  size_t n = min(len, pending.size());
+  memcpy(buf, pending.data(), n);
+  pending.erase(0, n);
+  return n;
+}
+
+// Renders each ID of a successful batch response as text
+vector<string> decode_ids(const WireHeader& header, const vector<uint8_t>& p) {
+  vector<string> ids;
+  size_t pos = 0;
+  for (uint32_t i = 0; i < header.count; ++i) {
+    if (header.format == FORMAT_U64 && pos + 8 <= p.size()) {
+      ids.push_back(to_string(wire_get_le64(&p[pos])));
+      pos += 8;
+    } else if (header.format == FORMAT_U128 && pos + 16 <= p.size()) {
+      char text[37];
+      snprintf(text, sizeof(text),
+               "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-"
+               "%02x%02x%02x%02x%02x%02x",
+               p[pos], p[pos + 1], p[pos + 2], p[pos + 3], p[pos + 4],
+               p[pos + 5], p[pos + 6], p[pos + 7], p[pos + 8], p[pos + 9],
+               p[pos + 10], p[pos + 11], p[pos + 12], p[pos + 13],
+               p[pos + 14], p[pos + 15]);
+      ids.push_back(text);
+      pos += 16;
+    } else if (header.format == FORMAT_TEXT && pos + 2 <= p.size()) {
+      uint16_t len = wire_get_le16(&p[pos]);
+      if (pos + 2 + len > p.size()) break;
+      ids.emplace_back(reinterpret_cast<const char*>(&p[pos + 2]), len);
+      pos += 2 + len;
+    } else {
+      break;
+    }
+  }
+  return ids;
+}
+
 void request_uuid(int thread_id) {
-  // Continuously request UUIDs from the Snowflake sidecar
-  while (true) {
-    int sock = 0;
-    struct sockaddr_in serv_addr;
+  int sock = -1;
+  string pending;
 
-    // 1. Create a TCP socket
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-      lock_guard<mutex> lock(cout_mutex);
-      cerr << "[Thread " << thread_id << "] Socket creation error" << endl;
-      this_thread::sleep_for(chrono::seconds(1));
-      continue;
+  // Continuously request UUIDs from the Snowflake sidecar, reusing the
+  // connection for as long as the sidecar keeps it open
+  while (true) {
+    if (sock < 0) {
+      if ((sock = connect_to_sidecar(thread_id)) < 0) {
+        this_thread::sleep_for(chrono::seconds(1));
+        continue;
+      }
+      pending.clear();
     }
 
-    // 2. Configure the server address (localhost:8080 for sidecar IPC)
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(8080);
+    // 5. Ask for a batch of IDs in whatever format the generator produces
+    WireHeader request;
+    request.count = BATCH_SIZE;
+    uint8_t frame[WIRE_HEADER_SIZE];
+    wire_encode_header(request, frame);
+    send(sock, frame, sizeof(frame), MSG_NOSIGNAL);
 
-    // 3. Convert IPv4 address from text to binary form
-    if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
-      lock_guard<mutex> lock(cout_mutex);
-      cerr << "[Thread " << thread_id
-           << "] Invalid address / Address not supported" << endl;
-      close(sock);
-      this_thread::sleep_for(chrono::seconds(1));
-      continue;
+    // 6. Read the response header. A one-shot sidecar ignores the request
+    // and answers with a single decimal/hex string before closing.
+    uint8_t head[WIRE_HEADER_SIZE];
+    size_t got = read_full(sock, pending, head, sizeof(head));
+    bool closed = true;
+    vector<string> ids;
+    string error;
+
+    if (got == sizeof(head) && head[0] == WIRE_MAGIC) {
+      WireHeader response = wire_decode_header(head);
+      vector<uint8_t> payload(response.length);
+      if (read_full(sock, pending, payload.data(), payload.size()) ==
+          payload.size()) {
+        closed = false;
+        if (response.status == STATUS_OK) {
+          ids = decode_ids(response, payload);
+        } else {
+          error = "sidecar error " + to_string(response.status);
+        }
+      }
+    } else if (got > 0) {
+      // Legacy one-shot reply: the rest of the stream is the ID
+      char rest[128] = {0};
+      size_t more = read_full(sock, pending, reinterpret_cast<uint8_t*>(rest),
+                              sizeof(rest) - 1);
+      ids.push_back(string(reinterpret_cast<char*>(head), got) +
+                    string(rest, more));
     }
 
-    // 4. Attempt to connect to the sidecar
-    if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+    {
       lock_guard<mutex> lock(cout_mutex);
-      cerr << "[Thread " << thread_id << "] Connection Failed. Retrying..."
-           << endl;
+      for (const string& id : ids) {
+        cout << "[Thread " << thread_id << "] Received UUID: " << id << endl;
+      }
+      if (ids.empty()) {
+        cerr << "[Thread " << thread_id << "] Failed to read UUID"
+             << (error.empty() ? "" : ": " + error) << endl;
+      }
+    }
+
+    // 7. Reconnect next time if the sidecar closed the socket
+    if (closed) {
       close(sock);
-      this_thread::sleep_for(chrono::seconds(1));
-      continue;
+      sock = -1;
+    }
+    this_thread::sleep_for(chrono::milliseconds(500));  // Request every 500ms
+  }
+}
+
+// Pops IDs from the sidecar's shared-memory ring instead of using sockets
+void pop_uuid_from_ring(int thread_id, string path) {
+  ShmRingConsumer ring(path);
+
+  while (true) {
+    // (Re)open the ring until the sidecar has created it
+    if (!ring.is_open() || ring.is_closed()) {
+      if (!ring.open()) {
+        lock_guard<mutex> lock(cout_mutex);
+        cerr << "[Thread " << thread_id << "] Shared-memory ring " << path
+             << " not ready. Retrying..." << endl;
+        this_thread::sleep_for(chrono::seconds(1));
+        continue;
+      }
     }
 
-    // 5. Read the UUID string from the socket
-    char buffer[128] = {0};
-    int valread = read(sock, buffer, sizeof(buffer) - 1);
+    uint64_t id;
+    bool ok = ring.slot_words() == 1 && ring.pop(&id, 1000);
 
     {
       lock_guard<mutex> lock(cout_mutex);
-      if (valread > 0) {
-        cout << "[Thread " << thread_id << "] Received UUID: " << buffer
-             << endl;
+      if (ok) {
+        cout << "[Thread " << thread_id << "] Received UUID: " << id << endl;
       } else {
         cerr << "[Thread " << thread_id << "] Failed to read UUID" << endl;
       }
     }
 
-    // 6. Close the socket and wait before the next request
-    close(sock);
     this_thread::sleep_for(chrono::milliseconds(500));  // Request every 500ms
   }
 }
@@ -77,10 +259,15 @@ int main() {
 
   const int NUM_THREADS = 5;
   vector<thread> threads;
+  const char* shm_ring_path = getenv("SHM_RING_PATH");
 
   // Spawn multiple threads to simulate concurrent requests
   for (int i = 0; i < NUM_THREADS; ++i) {
-    threads.emplace_back(request_uuid, i + 1);
+    if (shm_ring_path) {
+      threads.emplace_back(pop_uuid_from_ring, i + 1, string(shm_ring_path));
+    } else {
+      threads.emplace_back(request_uuid, i + 1);
+    }
   }
 
   // Join threads (will run indefinitely)
@@ -1,21 +1,24 @@
 #include "lib/id_generator.h"
 
-#include <arpa/inet.h>
-#include <ifaddrs.h>
-#include <netinet/in.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
-#include <cstring>
 #include <iostream>
 #include <memory>
+#include <vector>
 
+#include "lib/checkpoint/timestamp_checkpoint.h"
 #include "lib/db-auto-inc/db_auto_inc.h"
 #include "lib/dual-buffer/dual_buffer.h"
 #include "lib/etcd-snowflake/etcd_snowflake.h"
 #include "lib/hlc-snowflake/hlc_snowflake.h"
 #include "lib/insta-snowflake/insta_snowflake.h"
+#include "lib/metrics/instrumented_generator.h"
+#include "lib/metrics/metrics.h"
+#include "lib/metrics/metrics_server.h"
+#include "lib/server/server_config.h"
+#include "lib/server/server_pool.h"
+#include "lib/shm-ring/shm_ring.h"
 #include "lib/snowflake/snowflake.h"
 #include "lib/sonyflake/sonyflake.h"
 #include "lib/spanner-truetime/spanner_truetime_generator.h"
@@ -25,107 +28,131 @@
 
 using namespace std;
 
-int main() {
-  int server_fd, new_socket;
-  struct sockaddr_in address;
-  int opt = 1;
-  int addrlen = sizeof(address);
-
-  // ---------------------------------------------------------
-  // 1. Determine Generator Type
-  // ---------------------------------------------------------
-  const char* gen_type_env = getenv("GENERATOR_TYPE");
-  string gen_type = gen_type_env ? gen_type_env : "SNOWFLAKE";
-
-  unique_ptr<IdGenerator> generator;
+// Generators whose sequence space can be split between server workers
+static bool supports_sequence_slices(const string& gen_type) {
+  return gen_type == "SNOWFLAKE" || gen_type == "HLC_SNOWFLAKE" ||
+         gen_type == "INSTA_SNOWFLAKE" || gen_type == "SONYFLAKE";
+}
 
+/**
+ * Builds the generator selected by GENERATOR_TYPE. Generators that support
+ * sequence slices get slice `shard` of `shards`, so each server worker can
+ * own an independent instance without coordinating with the others.
+ */
+static unique_ptr<IdGenerator> create_generator(const string& gen_type,
+                                                uint64_t shard,
+                                                uint64_t shards) {
   if (gen_type == "HLC_SNOWFLAKE") {
     cout << "Initializing HLC Snowflake generator..." << endl;
-    generator = make_unique<HlcSnowflake>();
+    return make_unique<HlcSnowflake>(shard, shards);
   } else if (gen_type == "INSTA_SNOWFLAKE") {
     cout << "Initializing Instagram Snowflake generator..." << endl;
-    generator = make_unique<InstaSnowflake>();
+    return make_unique<InstaSnowflake>(shard, shards);
   } else if (gen_type == "SONYFLAKE") {
     cout << "Initializing Sonyflake generator..." << endl;
-    generator = make_unique<Sonyflake>();
+    return make_unique<Sonyflake>(shard, shards);
   } else if (gen_type == "UUIDV4") {
     cout << "Initializing UUID Version 4 generator..." << endl;
-    generator = make_unique<UuidV4Generator>();
+    return make_unique<UuidV4Generator>();
   } else if (gen_type == "UUIDV7") {
     cout << "Initializing UUID Version 7 generator..." << endl;
-    generator = make_unique<UuidV7Generator>();
+    return make_unique<UuidV7Generator>();
   } else if (gen_type == "DB_AUTO_INC") {
     cout << "Initializing Database Auto-Increment generator..." << endl;
-    generator = make_unique<DbAutoIncGenerator>();
+    return make_unique<DbAutoIncGenerator>();
   } else if (gen_type == "DUAL_BUFFER") {
     cout << "Initializing Dual Buffer generator..." << endl;
-    generator = make_unique<DualBufferGenerator>();
+    return make_unique<DualBufferGenerator>();
   } else if (gen_type == "ETCD_SNOWFLAKE") {
     cout << "Initializing Etcd-Coordinated Snowflake generator..." << endl;
-    generator = make_unique<EtcdSnowflake>();
+    return make_unique<EtcdSnowflake>();
   } else if (gen_type == "SPANNER") {
     cout << "Initializing Spanner Sequence generator..." << endl;
-    generator = make_unique<SpannerGenerator>();
+    return make_unique<SpannerGenerator>();
   } else if (gen_type == "SPANNER_TRUETIME") {
     cout << "Initializing Spanner TrueTime generator..." << endl;
-    generator = make_unique<SpannerTrueTimeGenerator>();
+    return make_unique<SpannerTrueTimeGenerator>();
   } else {
     cout << "Initializing Standard Snowflake generator..." << endl;
-    generator = make_unique<Snowflake>();
+    return make_unique<Snowflake>(shard, shards);
   }
+}
 
+int main() {
   // ---------------------------------------------------------
-  // 2. Setup TCP Server Socket
+  // 1. Determine Generator Type
   // ---------------------------------------------------------
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-    perror("Socket creation failed");
-    exit(EXIT_FAILURE);
-  }
-
-  // Allow reuse of address and port to prevent "Address already in use" errors
-  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt,
-                 sizeof(opt))) {
-    perror("setsockopt failed");
-    exit(EXIT_FAILURE);
-  }
+  const char* gen_type_env = getenv("GENERATOR_TYPE");
+  string gen_type = gen_type_env ? gen_type_env : "SNOWFLAKE";
 
-  // Configure server address to listen on all interfaces, port 8080
-  address.sin_family = AF_INET;
-  address.sin_addr.s_addr = INADDR_ANY;
-  address.sin_port = htons(8080);
+  ServerConfig config = ServerConfig::from_env();
 
-  // Bind the socket to the address
-  if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-    perror("Bind failed");
-    exit(EXIT_FAILURE);
+  // Enabled before any generator or server exists, so all of them record
+  if (config.metrics_port > 0) {
+    metrics_enabled = true;
+    if (!start_metrics_server(config.metrics_port)) {
+      exit(EXIT_FAILURE);
+    }
+    cout << "Serving Prometheus metrics on port " << config.metrics_port
+         << endl;
   }
 
-  // Start listening for incoming connections (max 3 pending connections)
-  if (listen(server_fd, 3) < 0) {
-    perror("Listen failed");
-    exit(EXIT_FAILURE);
+  // Opened before any generator exists, so all of them start after the
+  // restored high-water mark
+  if (!config.checkpoint_path.empty()) {
+    if (!open_process_checkpoint(config.checkpoint_path,
+                                 config.checkpoint_interval_ms)) {
+      exit(EXIT_FAILURE);
+    }
   }
 
-  cout << "Sidecar listening on port 8080..." << endl;
+  // Shardable generators get one instance per worker, each owning a slice of
+  // the sequence bits; all others are shared by every worker.
+  vector<unique_ptr<IdGenerator>> owned;
+  vector<IdGenerator*> generators;
+  uint64_t workers = config.worker_threads;
+  if (workers > 1 && supports_sequence_slices(gen_type)) {
+    for (uint64_t i = 0; i < workers; ++i) {
+      owned.push_back(create_generator(gen_type, i, workers));
+    }
+  } else {
+    owned.push_back(create_generator(gen_type, 0, 1));
+  }
+  // With metrics on, the servers call through latency-recording wrappers
+  vector<unique_ptr<IdGenerator>> instrumented;
+  if (metrics_enabled) {
+    string label = gen_type;
+    transform(label.begin(), label.end(), label.begin(),
+              [](unsigned char c) { return tolower(c); });
+    for (auto& generator : owned) {
+      instrumented.push_back(
+          make_unique<InstrumentedGenerator>(*generator, label));
+    }
+  }
+  const auto& serving = metrics_enabled ? instrumented : owned;
+  for (uint64_t i = 0; i < workers; ++i) {
+    generators.push_back(serving[i % serving.size()].get());
+  }
 
   // ---------------------------------------------------------
-  // 3. Main Server Loop
+  // 2. Start the Shared-Memory Ring (optional transport)
   // ---------------------------------------------------------
-  while (true) {
-    // Accept an incoming connection
-    if ((new_socket = accept(server_fd, (struct sockaddr*)&address,
-                             (socklen_t*)&addrlen)) < 0) {
-      perror("Accept failed");
-      continue;
+  unique_ptr<ShmRingProducer> shm_ring;
+  if (!config.shm_ring_path.empty()) {
+    shm_ring = make_unique<ShmRingProducer>(*generators[0],
+                                            config.shm_ring_path,
+                                            config.shm_ring_capacity);
+    if (!shm_ring->start()) {
+      exit(EXIT_FAILURE);
     }
-
-    // Generate a new UUID string and send it to the connected client
-    string uuid_str = generator->next_id_string();
-    send(new_socket, uuid_str.c_str(), uuid_str.length(), 0);
-
-    // Close the connection immediately after sending (stateless IPC)
-    close(new_socket);
   }
 
-  return 0;
+  // ---------------------------------------------------------
+  // 3. Run the Server Event Loops
+  // ---------------------------------------------------------
+  ServerPool pool(generators, config);
+  pool.run();
+
+  // run() only returns if a listener or event loop could not be set up
+  return EXIT_FAILURE;
 }
@@ -0,0 +1,180 @@
+#include "timestamp_checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+static const uint64_t CHECKPOINT_MAGIC = 0x54504b4346454e53ULL;  // "SNEFCKPT"
+static const uint64_t CHECKPOINT_VERSION = 1;
+static const size_t CHECKPOINT_FILE_SIZE = 4096;
+
+// Layout of the mapped file
+struct CheckpointFile {
+  uint64_t magic;
+  uint64_t version;
+  atomic<uint64_t> last_millis;  // No ID issued in this or a later ms
+};
+
+static_assert(sizeof(CheckpointFile) <= CHECKPOINT_FILE_SIZE,
+              "Checkpoint must fit its file");
+
+TimestampCheckpoint::TimestampCheckpoint(const string& path,
+                                         uint64_t interval_ms,
+                                         ClockSource& clock)
+    : path(path), interval_ms(interval_ms > 0 ? interval_ms : 1),
+      clock(clock) {}
+
+TimestampCheckpoint::~TimestampCheckpoint() {
+  if (is_running.exchange(false)) {
+    flush_thread.join();
+    flush();
+  }
+  if (file) {
+    munmap(file, CHECKPOINT_FILE_SIZE);
+  }
+  if (fd >= 0) {
+    close(fd);  // Also releases the lock
+  }
+}
+
+bool TimestampCheckpoint::open() {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror("Failed to open checkpoint");
+    return false;
+  }
+
+  if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+    cerr << "Checkpoint " << path << " is in use by another process" << endl;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      (static_cast<size_t>(st.st_size) < CHECKPOINT_FILE_SIZE &&
+       ftruncate(fd, CHECKPOINT_FILE_SIZE) < 0)) {
+    perror("Failed to size checkpoint");
+    return false;
+  }
+
+  void* p = mmap(nullptr, CHECKPOINT_FILE_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    perror("Failed to map checkpoint");
+    return false;
+  }
+  file = static_cast<CheckpointFile*>(p);
+
+  if (file->magic == CHECKPOINT_MAGIC &&
+      file->version == CHECKPOINT_VERSION) {
+    // The stored bound held until the next flush was due; the margin
+    // covers that flush running up to an interval late
+    floor = file->last_millis.load() + interval_ms;
+
+    // A fast restart only has to wait out the bound and the margin
+    uint64_t now = clock.now_millis();
+    if (floor >= now && floor - now <= 3 * interval_ms) {
+      this_thread::sleep_for(chrono::milliseconds(floor - now + 1));
+    }
+    cout << "Restored checkpoint " << path << ": issuing IDs after "
+         << floor << endl;
+  } else {
+    // Fresh (zero-filled) or foreign file
+    file->version = CHECKPOINT_VERSION;
+    file->last_millis.store(0);
+    file->magic = CHECKPOINT_MAGIC;
+    cout << "Created checkpoint " << path << endl;
+  }
+
+  // Cover the first interval before any ID is issued in it
+  uint64_t now = clock.now_millis();
+  file->last_millis.store((now > floor ? now : floor) + interval_ms);
+  msync(file, CHECKPOINT_FILE_SIZE, MS_ASYNC);
+
+  is_running = true;
+  flush_thread = thread(&TimestampCheckpoint::flush_loop, this);
+  return true;
+}
+
+void TimestampCheckpoint::flush() {
+  uint64_t high = 0;
+  {
+    lock_guard<mutex> lock(sources_mtx);
+    for (auto& source : sources) {
+      uint64_t issued = source.second();
+      if (issued > high) {
+        high = issued;
+      }
+    }
+  }
+  // Read last, so the time spent in the sources does not eat the interval
+  uint64_t now = clock.now_millis();
+  if (now > high) {
+    high = now;
+  }
+
+  // Ahead by one interval, so IDs issued before the next flush stay below
+  // it; never moves back, even if the clock does
+  high += interval_ms;
+  if (high > file->last_millis.load()) {
+    file->last_millis.store(high);
+    msync(file, CHECKPOINT_FILE_SIZE, MS_ASYNC);
+  }
+}
+
+void TimestampCheckpoint::flush_loop() {
+  // Fixed deadlines, so the time a flush takes does not stretch the period
+  auto next = chrono::steady_clock::now();
+  while (is_running.load()) {
+    next += chrono::milliseconds(interval_ms);
+    this_thread::sleep_until(next);
+    flush();
+
+    // After a stall, flush once and pace from now instead of catching up
+    auto now = chrono::steady_clock::now();
+    if (next < now) {
+      next = now;
+    }
+  }
+}
+
+uint64_t TimestampCheckpoint::add_source(
+    function<uint64_t()> last_issued_millis) {
+  lock_guard<mutex> lock(sources_mtx);
+  uint64_t handle = next_handle++;
+  sources.emplace_back(handle, move(last_issued_millis));
+  return handle;
+}
+
+void TimestampCheckpoint::remove_source(uint64_t handle) {
+  lock_guard<mutex> lock(sources_mtx);
+  for (auto it = sources.begin(); it != sources.end(); ++it) {
+    if (it->first == handle) {
+      sources.erase(it);
+      return;
+    }
+  }
+}
+
+// Never destroyed: detached server threads may issue IDs during exit
+static TimestampCheckpoint* checkpoint = nullptr;
+
+bool open_process_checkpoint(const string& path, uint64_t interval_ms) {
+  auto opened = make_unique<TimestampCheckpoint>(path, interval_ms);
+  if (!opened->open()) {
+    return false;
+  }
+  checkpoint = opened.release();
+  return true;
+}
+
+TimestampCheckpoint* process_checkpoint() { return checkpoint; }
@@ -0,0 +1,94 @@
+#ifndef TIMESTAMP_CHECKPOINT_H
+#define TIMESTAMP_CHECKPOINT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../clock/clock_source.h"
+
+struct CheckpointFile;
+
+/**
+ * Crash-safe high-water mark for the time-based generators, kept in a
+ * memory-mapped file.
+ *
+ * Generators register a source reporting the last millisecond they issued
+ * an ID in. A background thread, woken on fixed deadlines every
+ * `interval_ms`, writes the maximum of those and the clock, plus
+ * `interval_ms`, into the file, followed by an asynchronous msync(). The
+ * stored value thus bounds the milliseconds issued until the next flush is
+ * due. The page cache keeps it across a process crash, so a restart costs
+ * milliseconds and needs no coordination with etcd.
+ *
+ * On open() floor_millis() is the stored value plus another `interval_ms`,
+ * a margin for a last flush that ran up to an interval late, and restored
+ * generators only issue IDs in later milliseconds. When the clock is
+ * within about three intervals of the floor, open() sleeps until it passes
+ * it; a clock further behind is left to the generator's own handling of a
+ * clock step backwards. The bound covers generators whose time advances no
+ * faster than the clock; an HlcSnowflake that is borrowing logical time
+ * faster than that can outrun it.
+ *
+ * Only one process may use a file at a time; it holds flock(LOCK_EX).
+ */
+class TimestampCheckpoint {
+ private:
+  std::string path;
+  uint64_t interval_ms;
+  ClockSource& clock;
+
+  int fd = -1;
+  CheckpointFile* file = nullptr;
+  uint64_t floor = 0;
+
+  std::mutex sources_mtx;  // Guards sources and next_handle
+  std::vector<std::pair<uint64_t, std::function<uint64_t()>>> sources;
+  uint64_t next_handle = 1;
+
+  std::thread flush_thread;
+  std::atomic<bool> is_running{false};
+
+  void flush();
+  void flush_loop();
+
+ public:
+  TimestampCheckpoint(const std::string& path, uint64_t interval_ms,
+                      ClockSource& clock = default_clock_source());
+  ~TimestampCheckpoint();
+
+  TimestampCheckpoint(const TimestampCheckpoint&) = delete;
+  TimestampCheckpoint& operator=(const TimestampCheckpoint&) = delete;
+
+  // Maps (creating if needed) the file, restores the floor and starts the
+  // flush thread
+  bool open();
+
+  // Unix milliseconds restored generators must stay above (0 if fresh)
+  uint64_t floor_millis() const { return floor; }
+
+  /**
+   * @param last_issued_millis Returns the last millisecond the caller issued
+   * an ID in, or 0 if none; called from the flush thread
+   * @return Handle for remove_source()
+   */
+  uint64_t add_source(std::function<uint64_t()> last_issued_millis);
+  void remove_source(uint64_t handle);
+};
+
+/**
+ * Opens the process-wide checkpoint. Called once at startup, before any
+ * generator exists.
+ */
+bool open_process_checkpoint(const std::string& path, uint64_t interval_ms);
+
+// The process-wide checkpoint, or nullptr if none was opened
+TimestampCheckpoint* process_checkpoint();
+
+#endif  // TIMESTAMP_CHECKPOINT_H
@@ -0,0 +1,239 @@
+#include "clock_source.h"
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CLOCK_SOURCE_X86 1
+#endif
+
+using namespace std;
+
+static uint64_t clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t SystemClockSource::now_millis() {
+  return chrono::duration_cast<chrono::milliseconds>(
+             chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t CoarseClockSource::now_millis() {
+  return clock_ns(CLOCK_REALTIME_COARSE) / 1000000;
+}
+
+MonotonicClockSource::MonotonicClockSource()
+    : offset_ns(clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_MONOTONIC)) {}
+
+uint64_t MonotonicClockSource::now_millis() {
+  return (clock_ns(CLOCK_MONOTONIC) + offset_ns) / 1000000;
+}
+
+// ---------------------------------------------------------
+// TSC
+// ---------------------------------------------------------
+
+static bool has_invariant_tsc() {
+#ifdef CLOCK_SOURCE_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) {
+    return false;
+  }
+  __cpuid(0x80000007, eax, ebx, ecx, edx);
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+static uint64_t read_tsc() {
+#ifdef CLOCK_SOURCE_X86
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Nanoseconds per tick in 32.32 fixed point
+static uint64_t rate_q32(uint64_t ns, uint64_t ticks) {
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(ns) << 32) /
+                               ticks);
+}
+
+TscClockSource::TscClockSource() {
+  if (!has_invariant_tsc()) {
+    return;
+  }
+
+  // Measure the TSC frequency against CLOCK_REALTIME over ~20 ms
+  uint64_t start_tsc = read_tsc();
+  uint64_t start_ns = clock_ns(CLOCK_REALTIME);
+  struct timespec pause = {0, 20000000};
+  nanosleep(&pause, nullptr);
+  uint64_t end_tsc = read_tsc();
+  uint64_t end_ns = clock_ns(CLOCK_REALTIME);
+  if (end_tsc <= start_tsc || end_ns <= start_ns) {
+    return;
+  }
+
+  calibrated_rate = rate_q32(end_ns - start_ns, end_tsc - start_tsc);
+  reanchor_ticks = (end_tsc - start_tsc) * 50;
+  anchor_tsc.store(end_tsc, memory_order_relaxed);
+  anchor_ns.store(end_ns, memory_order_relaxed);
+  anchor_rate.store(calibrated_rate, memory_order_relaxed);
+  calibrated = calibrated_rate > 0;
+}
+
+TscClockSource::Anchor TscClockSource::load_anchor() const {
+  while (true) {
+    uint64_t seq = anchor_seq.load(memory_order_acquire);
+    if (seq & 1) {
+      continue;  // Being rewritten; takes a few stores
+    }
+    Anchor anchor = {anchor_tsc.load(memory_order_relaxed),
+                     anchor_ns.load(memory_order_relaxed),
+                     anchor_rate.load(memory_order_relaxed)};
+    atomic_thread_fence(memory_order_acquire);
+    if (anchor_seq.load(memory_order_relaxed) == seq) {
+      return anchor;
+    }
+  }
+}
+
+uint64_t TscClockSource::to_ns(const Anchor& anchor, uint64_t tsc) const {
+  uint64_t delta = tsc > anchor.tsc ? tsc - anchor.tsc : 0;
+  return anchor.realtime_ns +
+         static_cast<uint64_t>(
+             (static_cast<unsigned __int128>(delta) * anchor.ns_per_tsc_q32) >>
+             32);
+}
+
+void TscClockSource::reanchor(uint64_t tsc) {
+  if (reanchoring.test_and_set(memory_order_acquire)) {
+    return;  // Someone else is already doing it
+  }
+
+  // Only this caller writes the anchor; it may have moved since the caller
+  // read it
+  Anchor anchor = load_anchor();
+  if (tsc > anchor.tsc && tsc - anchor.tsc > reanchor_ticks) {
+    // Snap to CLOCK_REALTIME, even if that is behind what readers have
+    // seen (now_millis() holds them until it catches up), and take the
+    // frequency from the last interval unless the wall clock was stepped
+    uint64_t wall = clock_ns(CLOCK_REALTIME);
+    uint64_t rate = anchor.ns_per_tsc_q32;
+    if (wall > anchor.realtime_ns) {
+      uint64_t measured =
+          rate_q32(wall - anchor.realtime_ns, tsc - anchor.tsc);
+      uint64_t tolerance = calibrated_rate / 100;
+      if (measured + tolerance >= calibrated_rate &&
+          measured <= calibrated_rate + tolerance) {
+        rate = measured;
+      }
+    }
+
+    uint64_t seq = anchor_seq.load(memory_order_relaxed);
+    anchor_seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    anchor_tsc.store(tsc, memory_order_relaxed);
+    anchor_ns.store(wall, memory_order_relaxed);
+    anchor_rate.store(rate, memory_order_relaxed);
+    anchor_seq.store(seq + 2, memory_order_release);
+  }
+
+  reanchoring.clear(memory_order_release);
+}
+
+uint64_t TscClockSource::now_millis() {
+  uint64_t tsc = read_tsc();
+  Anchor anchor = load_anchor();
+  if (tsc > anchor.tsc && tsc - anchor.tsc > reanchor_ticks) {
+    reanchor(tsc);
+  }
+  uint64_t millis = to_ns(anchor, tsc) / 1000000;
+
+  // Only a new millisecond writes the shared line
+  uint64_t seen = max_millis.load(memory_order_relaxed);
+  while (millis > seen &&
+         !max_millis.compare_exchange_weak(seen, millis,
+                                           memory_order_relaxed)) {
+  }
+  return millis > seen ? millis : seen;
+}
+
+// ---------------------------------------------------------
+// Ticker
+// ---------------------------------------------------------
+
+TickerClockSource::TickerClockSource() {
+  // Publish once before anyone can read
+  published_ms.store(clock_ns(CLOCK_REALTIME) / 1000000);
+  ticker = thread(&TickerClockSource::run, this);
+}
+
+TickerClockSource::~TickerClockSource() {
+  is_running = false;
+  if (ticker.joinable()) {
+    ticker.join();
+  }
+}
+
+void TickerClockSource::run() {
+  while (is_running.load(memory_order_relaxed)) {
+    uint64_t now_ns = clock_ns(CLOCK_REALTIME);
+    published_ms.store(now_ns / 1000000, memory_order_relaxed);
+
+    // Sleep until the next millisecond boundary
+    uint64_t wake_ns = (now_ns / 1000000 + 1) * 1000000;
+    struct timespec wake = {static_cast<time_t>(wake_ns / 1000000000),
+                            static_cast<long>(wake_ns % 1000000000)};
+    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, nullptr);
+  }
+}
+
+// ---------------------------------------------------------
+// Selection
+// ---------------------------------------------------------
+
+static unique_ptr<ClockSource> create_clock_source() {
+  string type = getenv("CLOCK_SOURCE") ? getenv("CLOCK_SOURCE") : "SYSTEM";
+
+  if (type == "COARSE") {
+    return make_unique<CoarseClockSource>();
+  } else if (type == "MONOTONIC") {
+    return make_unique<MonotonicClockSource>();
+  } else if (type == "TICKER") {
+    return make_unique<TickerClockSource>();
+  } else if (type == "TSC") {
+    auto tsc = make_unique<TscClockSource>();
+    if (tsc->usable()) {
+      return tsc;
+    }
+    cerr << "Warning: no invariant TSC; falling back to the SYSTEM clock"
+         << endl;
+  } else if (type != "SYSTEM") {
+    cerr << "Warning: unknown CLOCK_SOURCE " << type
+         << "; using the SYSTEM clock" << endl;
+  }
+  return make_unique<SystemClockSource>();
+}
+
+ClockSource& default_clock_source() {
+  // Never destroyed: detached server threads may read it during exit
+  static ClockSource* clock = [] {
+    unique_ptr<ClockSource> created = create_clock_source();
+    cout << "Using the " << created->name() << " clock source" << endl;
+    return created.release();
+  }();
+  return *clock;
+}
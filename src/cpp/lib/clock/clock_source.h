@@ -0,0 +1,154 @@
+#ifndef CLOCK_SOURCE_H
+#define CLOCK_SOURCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * Wall-clock time in Unix milliseconds for the time-based generators.
+ *
+ * Generators take a ClockSource by reference (default_clock_source() unless
+ * told otherwise), so the cost of reading the clock can be chosen per
+ * deployment with CLOCK_SOURCE, and tests can drive a ManualClockSource.
+ */
+class ClockSource {
+ public:
+  virtual ~ClockSource() = default;
+
+  virtual uint64_t now_millis() = 0;
+
+  // Name used in the startup log
+  virtual const char* name() const = 0;
+};
+
+// std::chrono::system_clock, as the generators always used (vDSO, ~20 ns)
+class SystemClockSource : public ClockSource {
+ public:
+  uint64_t now_millis() override;
+  const char* name() const override { return "SYSTEM"; }
+};
+
+/**
+ * CLOCK_REALTIME_COARSE: the time of the last kernel tick, read without
+ * touching the hardware counter. It advances in steps of 1-4 ms (the
+ * kernel's HZ), which also caps how often a new millisecond's sequence
+ * numbers become available.
+ */
+class CoarseClockSource : public ClockSource {
+ public:
+  uint64_t now_millis() override;
+  const char* name() const override { return "COARSE"; }
+};
+
+/**
+ * CLOCK_MONOTONIC plus the wall-clock offset measured at startup. It never
+ * steps backwards, whatever NTP or an operator does to the wall clock, but
+ * it does not follow steps forward either and drifts from wall time as
+ * the kernel slews it.
+ */
+class MonotonicClockSource : public ClockSource {
+ private:
+  uint64_t offset_ns;
+
+ public:
+  MonotonicClockSource();
+  uint64_t now_millis() override;
+  const char* name() const override { return "MONOTONIC"; }
+};
+
+/**
+ * Reads the CPU's time-stamp counter and converts it with a frequency
+ * calibrated against CLOCK_REALTIME at startup.
+ *
+ * The conversion is re-anchored to CLOCK_REALTIME about once a second by
+ * whichever caller notices, which also re-measures the frequency over that
+ * second, so calibration error, drift and NTP slewing are picked up. The
+ * anchor is published under a sequence lock, so readers never see half of
+ * one, and the result never decreases: a reader whose TSC lags another
+ * core's, or whose clock was pulled back by a re-anchor, gets the highest
+ * millisecond already returned. Only usable on x86 CPUs with an invariant
+ * TSC (usable() reports this).
+ */
+class TscClockSource : public ClockSource {
+ private:
+  struct Anchor {
+    uint64_t tsc;
+    uint64_t realtime_ns;
+    uint64_t ns_per_tsc_q32;  // Nanoseconds per TSC tick, 32.32 fixed point
+  };
+
+  // Odd while the re-anchoring caller rewrites the anchor_* fields;
+  // readers retry if it was odd or changed while they read them
+  alignas(64) std::atomic<uint64_t> anchor_seq{0};
+  std::atomic<uint64_t> anchor_tsc{0};
+  std::atomic<uint64_t> anchor_ns{0};
+  std::atomic<uint64_t> anchor_rate{0};
+  std::atomic_flag reanchoring = ATOMIC_FLAG_INIT;
+  uint64_t calibrated_rate = 0;  // ns_per_tsc_q32 measured at startup
+  uint64_t reanchor_ticks = 0;   // TSC ticks between re-anchors (~1 s)
+  bool calibrated = false;
+
+  alignas(64) std::atomic<uint64_t> max_millis{0};  // Highest returned
+
+  Anchor load_anchor() const;
+  uint64_t to_ns(const Anchor& anchor, uint64_t tsc) const;
+  void reanchor(uint64_t tsc);
+
+ public:
+  TscClockSource();
+
+  // False if the CPU has no invariant TSC or calibration failed
+  bool usable() const { return calibrated; }
+
+  uint64_t now_millis() override;
+  const char* name() const override { return "TSC"; }
+};
+
+/**
+ * A background thread publishes the current millisecond into a cache-line
+ * aligned atomic, waking at every millisecond boundary; reading the clock
+ * is a single relaxed load. The published value can lag the real clock by
+ * the thread's wake-up latency (typically well under 1 ms).
+ */
+class TickerClockSource : public ClockSource {
+ private:
+  alignas(64) std::atomic<uint64_t> published_ms{0};
+  alignas(64) std::atomic<bool> is_running{true};
+  std::thread ticker;
+
+  void run();
+
+ public:
+  TickerClockSource();
+  ~TickerClockSource();
+
+  uint64_t now_millis() override {
+    return published_ms.load(std::memory_order_relaxed);
+  }
+  const char* name() const override { return "TICKER"; }
+};
+
+// Time only moves when told to; for deterministic tests
+class ManualClockSource : public ClockSource {
+ private:
+  std::atomic<uint64_t> millis;
+
+ public:
+  explicit ManualClockSource(uint64_t start_millis) : millis(start_millis) {}
+
+  void set_millis(uint64_t value) { millis.store(value); }
+  void advance(uint64_t delta) { millis.fetch_add(delta); }
+
+  uint64_t now_millis() override { return millis.load(); }
+  const char* name() const override { return "MANUAL"; }
+};
+
+/**
+ * The process-wide clock selected by CLOCK_SOURCE (SYSTEM, COARSE,
+ * MONOTONIC, TSC or TICKER; default SYSTEM). Created on first use. TSC
+ * falls back to SYSTEM where it is unusable.
+ */
+ClockSource& default_clock_source();
+
+#endif  // CLOCK_SOURCE_H
@@ -1,75 +1,163 @@
 #include "db_auto_inc.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
-#include <stdexcept>
 
 using namespace std;
 
-DbAutoIncGenerator::DbAutoIncGenerator() {
-  conn = mysql_init(NULL);
-  if (conn == NULL) {
-    throw runtime_error("mysql_init() failed");
+static MysqlPoolConfig pool_config() {
+  // In Kubernetes, the ProxySQL service is named 'proxysql'
+  MysqlPoolConfig config =
+      MysqlPoolConfig::from_env("proxysql", 6033);  // ProxySQL default port
+  config.disable_ssl = true;
+  // Ensure the tickets table exists
+  config.init_queries.push_back(
+      "CREATE TABLE IF NOT EXISTS tickets (id BIGINT UNSIGNED AUTO_INCREMENT "
+      "PRIMARY KEY, stub CHAR(1) NOT NULL UNIQUE) ENGINE=InnoDB");
+  return config;
+}
+
+DbAutoIncGenerator::DbAutoIncGenerator()
+    : block_size(getenv("DB_AUTO_INC_BLOCK")
+                     ? strtoull(getenv("DB_AUTO_INC_BLOCK"), nullptr, 10)
+                     : 1),
+      pipeline(getenv("DB_AUTO_INC_PIPELINE")
+                   ? strtoull(getenv("DB_AUTO_INC_PIPELINE"), nullptr, 10)
+                   : 1),
+      query_latency(backend_latency("db_auto_inc", "replace_into")),
+      pool(pool_config()) {
+  block_size = max<uint64_t>(1, min(block_size, MAX_BLOCK));
+  pipeline = max<uint64_t>(1, pipeline);
+
+  // One row per ticket; every row hits the same stub, so the table still
+  // holds a single row afterwards
+  replace_query = "REPLACE INTO tickets (stub) VALUES ('a')";
+  for (uint64_t i = 1; i < block_size; ++i) {
+    replace_query += ", ('a')";
   }
-  connect();
 }
 
-DbAutoIncGenerator::~DbAutoIncGenerator() {
-  if (conn) {
-    mysql_close(conn);
+// Called with mtx held
+bool DbAutoIncGenerator::reserve_blocks() {
+  // The REPLACE INTO statement updates the single row with stub='a',
+  // forcing the AUTO_INCREMENT counter to increase (once per row).
+  vector<uint64_t> firsts(pipeline);
+  vector<uint64_t> increments(pipeline);
+  // A single ticket needs no spacing
+  uint64_t* wanted = block_size > 1 ? increments.data() : nullptr;
+  size_t reserved;
+  {
+    ScopedLatency timer(query_latency);
+    reserved = pool.execute_concurrently(replace_query, pipeline,
+                                         firsts.data(), wanted);
+    if (reserved == 0) {
+      // Failed connections are repaired in the background; retry once on
+      // the others
+      reserved = pool.execute_concurrently(replace_query, pipeline,
+                                           firsts.data(), wanted);
+    }
+  }
+  if (reserved == 0) {
+    cerr << "REPLACE INTO failed on every connection" << endl;
+    return false;
   }
+
+  size_t kept = spare.size();
+  for (size_t i = 0; i < reserved; ++i) {
+    // A block is only usable once its spacing is known; otherwise its
+    // tickets are skipped, never reused
+    if (block_size == 1 || increments[i] != 0) {
+      spare.push_back({firsts[i], increments[i]});
+    }
+  }
+  if (spare.size() == kept) {
+    return false;
+  }
+
+  // Lowest block last, so IDs are handed out roughly in order
+  sort(spare.begin(), spare.end(),
+       [](const SpareBlock& a, const SpareBlock& b) {
+         return a.first > b.first;
+       });
+  return true;
 }
 
-void DbAutoIncGenerator::connect() {
-  // Read connection details from environment variables or use defaults
-  // In Kubernetes, the ProxySQL service is named 'proxysql'
-  const char* host = getenv("DB_HOST") ? getenv("DB_HOST") : "proxysql";
-  const char* user = getenv("DB_USER") ? getenv("DB_USER") : "root";
-  const char* pass = getenv("DB_PASS") ? getenv("DB_PASS") : "root";
-  const char* dbname = getenv("DB_NAME") ? getenv("DB_NAME") : "uuid_db";
-  int port = getenv("DB_PORT") ? atoi(getenv("DB_PORT"))
-                               : 6033;  // ProxySQL default port
-
-  // Connect to ProxySQL (or directly to MySQL)
-  unsigned int ssl_mode = SSL_MODE_DISABLED;
-  mysql_options(conn, MYSQL_OPT_SSL_MODE, &ssl_mode);
-  if (mysql_real_connect(conn, host, user, pass, dbname, port, NULL, 0) ==
-      NULL) {
-    cerr << "mysql_real_connect() failed: " << mysql_error(conn) << endl;
-    // We don't throw here to allow retries during next_id()
-  } else {
-    // Ensure the tickets table exists
-    const char* query =
-        "CREATE TABLE IF NOT EXISTS tickets (id BIGINT UNSIGNED AUTO_INCREMENT "
-        "PRIMARY KEY, stub CHAR(1) NOT NULL UNIQUE) ENGINE=InnoDB";
-    if (mysql_query(conn, query)) {
-      cerr << "Failed to create table: " << mysql_error(conn) << endl;
+size_t DbAutoIncGenerator::take_from_block(uint64_t* out, size_t n) {
+  uint64_t current = block.load(memory_order_acquire);
+  while (true) {
+    uint64_t left = current >> BLOCK_ID_BITS;
+    if (left == 0) {
+      return 0;
+    }
+    uint64_t taken = min<uint64_t>(left, n);
+    uint64_t first = current & BLOCK_ID_MASK;
+    uint64_t step = increment.load(memory_order_relaxed);
+    uint64_t next = ((left - taken) << BLOCK_ID_BITS) | (first + taken * step);
+    if (block.compare_exchange_weak(current, next, memory_order_acquire)) {
+      for (uint64_t i = 0; i < taken; ++i) {
+        out[i] = first + i * step;
+      }
+      return taken;
     }
   }
 }
 
-uint64_t DbAutoIncGenerator::next_id() {
-  // Lock to ensure thread-safe access to the single MySQL connection
+size_t DbAutoIncGenerator::refill_and_take(uint64_t* out, size_t n) {
+  // One refill at a time; it fans out over the pool itself
   lock_guard<mutex> lock(mtx);
 
-  // The REPLACE INTO statement updates the single row with stub='a',
-  // forcing the AUTO_INCREMENT counter to increase.
-  const char* query = "REPLACE INTO tickets (stub) VALUES ('a')";
+  // Another caller may have refilled the block while we waited
+  size_t taken = take_from_block(out, n);
+  if (taken > 0) {
+    return taken;
+  }
 
-  if (mysql_query(conn, query)) {
-    cerr << "REPLACE INTO failed: " << mysql_error(conn) << endl;
+  if (spare.empty() && !reserve_blocks()) {
+    return 0;  // Return 0 on failure
+  }
+  SpareBlock reserved = spare.back();
+  spare.pop_back();
+  uint64_t first = reserved.first;
+  uint64_t step = reserved.increment;
 
-    // Attempt to reconnect and retry once
-    mysql_close(conn);
-    conn = mysql_init(NULL);
-    connect();
+  taken = min<uint64_t>(n, block_size);
+  for (uint64_t i = 0; i < taken; ++i) {
+    out[i] = first + i * step;
+  }
 
-    if (mysql_query(conn, query)) {
-      cerr << "Retry failed: " << mysql_error(conn) << endl;
-      return 0;  // Return 0 on failure
+  uint64_t left = block_size - taken;
+  if (left > 0) {
+    uint64_t next = first + taken * step;
+    if (next + left * step > BLOCK_ID_MASK) {
+      // Cannot be packed; skipping the rest leaves a gap, never a duplicate
+      cerr << "Tickets past 2^48 cannot be served from a block; dropping "
+           << left << " tickets" << endl;
+    } else {
+      // `block` is empty, so no CAS can pair its old tickets with `step`
+      increment.store(step, memory_order_relaxed);
+      block.store((left << BLOCK_ID_BITS) | next, memory_order_release);
     }
   }
+  return taken;
+}
+
+uint64_t DbAutoIncGenerator::next_id() {
+  uint64_t id;
+  return next_ids(&id, 1) == 1 ? id : 0;
+}
 
-  // Retrieve the newly generated ID
-  return mysql_insert_id(conn);
+size_t DbAutoIncGenerator::next_ids(uint64_t* out, size_t n) {
+  size_t filled = 0;
+  while (filled < n) {
+    size_t taken = take_from_block(out + filled, n - filled);
+    if (taken == 0) {
+      taken = refill_and_take(out + filled, n - filled);
+      if (taken == 0) {
+        break;
+      }
+    }
+    filled += taken;
+  }
+  return filled;
 }
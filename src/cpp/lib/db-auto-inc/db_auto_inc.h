@@ -3,29 +3,73 @@
 
 #include <mysql/mysql.h>
 
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "../mysql-pool/mysql_pool.h"
 
 /**
  * Database Auto-Increment ID Generator
  *
  * Uses a Multi-Master MySQL setup (Flickr Ticket Server pattern)
  * to generate unique 64-bit IDs using the AUTO_INCREMENT feature.
+ *
+ * With DB_AUTO_INC_BLOCK=N (N > 1) one round trip reserves N tickets: a
+ * multi-row `REPLACE INTO tickets (stub) VALUES ('a'), ('a'), ...` makes
+ * InnoDB allocate N auto-increment values at once, so they are consecutive
+ * steps of the master's auto_increment_increment starting at
+ * LAST_INSERT_ID(). The increment is read on the connection that ran the
+ * REPLACE, so each master's blocks use its own. Each master keeps its own
+ * offset (odd/even), and other clients, block or not, draw from the same
+ * counter. The block is then
+ * handed out lock-free from `block`; only a refill takes the refill mutex.
+ *
+ * Queries go through a MysqlPool (DB_HOSTS lists both masters). With
+ * DB_AUTO_INC_PIPELINE=P a refill sends the REPLACE on up to P idle
+ * connections at once; the extra blocks wait in `spare` for the next
+ * refills.
  */
 class DbAutoIncGenerator : public IdGenerator {
  private:
-  MYSQL* conn;
-  std::mutex mtx;
+  // Packs the next ticket of the current block (low 48 bits) and how many
+  // remain (high 16 bits), so both advance with one CAS
+  static const int BLOCK_ID_BITS = 48;
+  static const uint64_t BLOCK_ID_MASK =
+      (static_cast<uint64_t>(1) << BLOCK_ID_BITS) - 1;
+  static const uint64_t MAX_BLOCK = 65535;
+
+  alignas(64) std::atomic<uint64_t> block{0};
+  // Spacing of the tickets in `block`; only changes while it is empty, and
+  // a CAS on `block` fails if it was swapped after `increment` was read
+  std::atomic<uint64_t> increment{0};
+
+  // A reserved block: its first ticket and its master's increment
+  struct SpareBlock {
+    uint64_t first;
+    uint64_t increment;
+  };
+
+  alignas(64) std::mutex mtx;  // Guards block refills and spare
+  std::vector<SpareBlock> spare;  // Reserved, unused blocks
+  uint64_t block_size;
+  uint64_t pipeline;
+  std::string replace_query;
+  LatencyHistogram& query_latency;
+  MysqlPool pool;
 
-  void connect();
+  bool reserve_blocks();
+  size_t take_from_block(uint64_t* out, size_t n);
+  size_t refill_and_take(uint64_t* out, size_t n);
 
  public:
   DbAutoIncGenerator();
-  ~DbAutoIncGenerator();
 
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
 };
 
 #endif  // DB_AUTO_INC_H
@@ -1,176 +1,436 @@
 #include "dual_buffer.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 
 using namespace std;
 
+static const char* const DEFAULT_TAG = "default";
+static const char* const RESERVE_SEGMENT =
+    "UPDATE id_segments SET max_id = LAST_INSERT_ID(max_id + ?) "
+    "WHERE biz_tag = ?";
+static const char* const SELECT_STEP =
+    "SELECT step FROM id_segments WHERE biz_tag = ?";
+
+// Leaf's defaults: segments should last about 15 minutes, at most 1M IDs
+static const uint64_t DEFAULT_TARGET_MS = 15 * 60 * 1000;
+static const uint64_t DEFAULT_MAX_STEP = 1000000;
+
+static const uint64_t DEFAULT_MAX_TAGS = 1024;
+static const uint64_t DEFAULT_TAG_IDLE_MS = 10 * 60 * 1000;
+static const uint64_t DEFAULT_FETCHERS = 2;
+static const chrono::seconds SWEEP_INTERVAL(1);
+
+static uint64_t env_or(const char* name, uint64_t fallback) {
+  return getenv(name) ? strtoull(getenv(name), nullptr, 10) : fallback;
+}
+
 DualBufferGenerator::DualBufferGenerator()
-    : current_pos(0), is_running(true), fetch_needed(false) {
-  conn = mysql_init(NULL);
-  if (conn == NULL) {
-    throw runtime_error("mysql_init() failed");
-  }
-  connect();
+    : ring_size(env_or("DUAL_BUFFER_SEGMENTS", 2)),
+      max_tags(env_or("DUAL_BUFFER_MAX_TAGS", DEFAULT_MAX_TAGS)),
+      tag_idle(env_or("DUAL_BUFFER_TAG_IDLE_MS", DEFAULT_TAG_IDLE_MS)),
+      is_running(true),
+      next_sweep(chrono::steady_clock::now() + SWEEP_INTERVAL),
+      fetch_latency(backend_latency("dual_buffer", "fetch_segment")),
+      pool(MysqlPoolConfig::from_env("mysql-dual-buffer", 3306)),
+      max_step(env_or("SEGMENT_MAX_STEP", DEFAULT_MAX_STEP)),
+      target_window(env_or("SEGMENT_TARGET_MS", DEFAULT_TARGET_MS)),
+      step_gauge(segment_step_gauge("dual_buffer")) {
+  ring_size = max<size_t>(ring_size, 2);
+  max_tags = max<size_t>(max_tags, 1);
+  default_buffer = make_shared<SegmentBuffer>(DEFAULT_TAG, ring_size);
 
   // Fetch the initial segment synchronously
-  if (!fetch_segment(0)) {
+  if (!fetch_next(*default_buffer)) {
     throw runtime_error("Failed to fetch initial ID segment from database");
   }
 
-  // Start the background fetcher thread
-  fetch_thread = thread(&DualBufferGenerator::background_fetcher, this);
+  // Start the background fetcher threads
+  size_t fetchers = max<uint64_t>(env_or("DUAL_BUFFER_FETCHERS",
+                                         DEFAULT_FETCHERS), 1);
+  for (size_t i = 0; i < fetchers; ++i) {
+    fetch_threads.emplace_back(&DualBufferGenerator::background_fetcher,
+                               this);
+  }
+  request_fetch(default_buffer);
 }
 
 DualBufferGenerator::~DualBufferGenerator() {
-  is_running = false;
-  cv_fetch.notify_one();
-  if (fetch_thread.joinable()) {
+  {
+    lock_guard<mutex> lock(mtx);
+    is_running = false;
+  }
+  cv_fetch.notify_all();
+  for (auto& fetch_thread : fetch_threads) {
     fetch_thread.join();
   }
-  if (conn) {
-    mysql_close(conn);
+}
+
+static void bind_tag(MYSQL_BIND& param, const string& tag,
+                     unsigned long* length) {
+  *length = tag.size();
+  param.buffer_type = MYSQL_TYPE_STRING;
+  param.buffer = const_cast<char*>(tag.data());
+  param.buffer_length = *length;
+  param.length = length;
+}
+
+// Only the default tag is expected to exist; it keeps retrying
+static void mark_missing(SegmentBuffer& buffer) {
+  cerr << "No id_segments row for biz_tag '" << buffer.tag << "'" << endl;
+  if (buffer.tag != DEFAULT_TAG) {
+    buffer.missing = true;
   }
 }
 
-void DualBufferGenerator::connect() {
-  const char* host =
-      getenv("DB_HOST") ? getenv("DB_HOST") : "mysql-dual-buffer";
-  const char* user = getenv("DB_USER") ? getenv("DB_USER") : "root";
-  const char* pass = getenv("DB_PASS") ? getenv("DB_PASS") : "root";
-  const char* dbname = getenv("DB_NAME") ? getenv("DB_NAME") : "uuid_db";
-  int port = getenv("DB_PORT") ? atoi(getenv("DB_PORT")) : 3306;
+bool DualBufferGenerator::read_min_step(SegmentBuffer& buffer) {
+  MysqlPool::Lease conn = pool.acquire();
+  if (!conn) {
+    cerr << "No database connection available" << endl;
+    return false;
+  }
+  MYSQL_STMT* select = conn.statement(SELECT_STEP);
+  if (select == nullptr) {
+    return false;
+  }
 
-  if (mysql_real_connect(conn, host, user, pass, dbname, port, NULL, 0) ==
-      NULL) {
-    cerr << "mysql_real_connect() failed: " << mysql_error(conn) << endl;
+  MYSQL_BIND param = {};
+  unsigned long length;
+  bind_tag(param, buffer.tag, &length);
+
+  uint64_t min_step = 0;
+  MYSQL_BIND column = {};
+  column.buffer_type = MYSQL_TYPE_LONGLONG;
+  column.buffer = &min_step;
+  column.is_unsigned = true;
+
+  if (mysql_stmt_bind_param(select, &param) || mysql_stmt_execute(select) ||
+      mysql_stmt_bind_result(select, &column) ||
+      mysql_stmt_store_result(select)) {
+    cerr << "SELECT step failed: " << mysql_stmt_error(select) << endl;
+    conn.mark_broken();
+    return false;
   }
+  int fetched = mysql_stmt_fetch(select);
+  mysql_stmt_free_result(select);
+  if (fetched != 0 || min_step == 0) {
+    mark_missing(buffer);
+    return false;
+  }
+
+  buffer.min_step = min_step;
+  buffer.step = min_step;
+  return true;
 }
 
-bool DualBufferGenerator::fetch_segment(int index) {
-  lock_guard<mutex> lock(db_mtx);
+static int64_t steady_now_ns() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t DualBufferGenerator::choose_step(SegmentBuffer& buffer) const {
+  // Without a segment run out since the last choice this fetch only
+  // prefills the ring (startup, a new tag, after a quiet spell), which
+  // says nothing about demand
+  uint64_t seen = buffer.lifetimes.load(memory_order_acquire);
+  if (seen == buffer.adapted_lifetimes) {
+    return buffer.step;
+  }
+  buffer.adapted_lifetimes = seen;
 
-  // Simple reconnect logic if connection dropped
-  if (mysql_ping(conn)) {
-    mysql_close(conn);
-    conn = mysql_init(NULL);
-    connect();
+  chrono::nanoseconds lasted(buffer.last_lifetime.load(memory_order_relaxed));
+  if (lasted < target_window) {
+    return min(buffer.step * 2, max(max_step, buffer.min_step));
   }
+  if (lasted >= target_window * 2) {
+    return max(buffer.step / 2, buffer.min_step);
+  }
+  return buffer.step;
+}
 
-  mysql_query(conn, "START TRANSACTION");
+bool DualBufferGenerator::fetch_segment(SegmentBuffer& buffer,
+                                        Segment& segment) {
+  ScopedLatency timer(fetch_latency);
 
-  if (mysql_query(conn,
-                  "UPDATE id_segments SET max_id = max_id + step WHERE biz_tag "
-                  "= 'default'")) {
-    cerr << "UPDATE failed: " << mysql_error(conn) << endl;
-    mysql_query(conn, "ROLLBACK");
+  MysqlPool::Lease conn = pool.acquire();
+  if (!conn) {
+    cerr << "No database connection available" << endl;
+    return false;
+  }
+  MYSQL_STMT* reserve = conn.statement(RESERVE_SEGMENT);
+  if (reserve == nullptr) {
     return false;
   }
 
-  if (mysql_query(
-          conn,
-          "SELECT max_id, step FROM id_segments WHERE biz_tag = 'default'")) {
-    cerr << "SELECT failed: " << mysql_error(conn) << endl;
-    mysql_query(conn, "ROLLBACK");
+  uint64_t next_step = choose_step(buffer);
+
+  MYSQL_BIND params[2] = {};
+  params[0].buffer_type = MYSQL_TYPE_LONGLONG;
+  params[0].buffer = &next_step;
+  params[0].is_unsigned = true;
+  unsigned long length;
+  bind_tag(params[1], buffer.tag, &length);
+
+  if (mysql_stmt_bind_param(reserve, params) || mysql_stmt_execute(reserve)) {
+    cerr << "UPDATE failed: " << mysql_stmt_error(reserve) << endl;
+    conn.mark_broken();
     return false;
   }
+  if (mysql_stmt_affected_rows(reserve) != 1) {
+    mark_missing(buffer);
+    return false;
+  }
+  // LAST_INSERT_ID(expr) hands the updated max_id back with the OK packet
+  uint64_t max_id = mysql_stmt_insert_id(reserve);
 
-  MYSQL_RES* result = mysql_store_result(conn);
-  bool success = false;
-  uint64_t max_id = 0;
-  uint64_t step = 0;
-  if (result) {
-    MYSQL_ROW row = mysql_fetch_row(result);
-    if (row) {
-      max_id = stoull(row[0]);
-      step = stoull(row[1]);
-      success = true;
-    }
-    mysql_free_result(result);
+  buffer.step = next_step;
+  if (&buffer == default_buffer.get()) {
+    step_gauge.set(next_step);
   }
 
-  mysql_query(conn, "COMMIT");
+  // Published by advancing `filled`; see take() for stale consumers
+  segment.next_id.store(max_id - next_step + 1, memory_order_release);
+  segment.max_id.store(max_id, memory_order_release);
+  return true;
+}
+
+bool DualBufferGenerator::fetch_next(SegmentBuffer& buffer) {
+  bool success = buffer.min_step > 0 || read_min_step(buffer);
+  uint64_t next = buffer.filled.load();
+  success = success && fetch_segment(buffer, buffer.ring[next % ring_size]);
 
-  if (success) {
-    lock_guard<mutex> mtx_lock(mtx);
-    segments[index].max_id = max_id;
-    segments[index].current_id = max_id - step + 1;
-    segments[index].step = step;
-    segments[index].is_ready = true;
+  if (success && next == 0) {
+    buffer.serving_since.store(steady_now_ns(), memory_order_relaxed);
+  }
+  if (success || buffer.missing) {
+    {
+      lock_guard<mutex> lock(mtx);
+      if (success) {
+        buffer.filled.store(next + 1, memory_order_release);
+      }
+    }
+    cv_consume.notify_all();  // Notify consumers that a segment is ready
   }
-
   return success;
 }
 
 void DualBufferGenerator::background_fetcher() {
-  while (is_running) {
-    unique_lock<mutex> lock(mtx);
-    // Wait until a fetch is needed or we are shutting down
-    cv_fetch.wait(lock,
-                  [this] { return fetch_needed.load() || !is_running.load(); });
-
-    if (!is_running) break;
+  while (true) {
+    shared_ptr<SegmentBuffer> buffer;
+    bool sweep = false;
+    {
+      unique_lock<mutex> lock(mtx);
+      // Wait until a buffer needs a segment or we are shutting down
+      cv_fetch.wait_for(lock, SWEEP_INTERVAL, [this] {
+        return !fetch_queue.empty() || !is_running.load();
+      });
+      if (!is_running) break;
 
-    int next_pos = 1 - current_pos;
-    lock.unlock();  // Unlock while fetching from DB (slow operation)
+      auto now = chrono::steady_clock::now();
+      if (now >= next_sweep) {
+        next_sweep = now + SWEEP_INTERVAL;
+        sweep = true;
+      }
+      if (!fetch_queue.empty()) {
+        buffer = move(fetch_queue.front());
+        fetch_queue.pop_front();
+      }
+    }
 
-    bool success = fetch_segment(next_pos);
+    if (sweep) {
+      sweep_idle_tags();
+    }
+    if (!buffer) {
+      continue;
+    }
 
-    lock.lock();
-    if (success) {
-      fetch_needed = false;
-      cv_consume
-          .notify_all();  // Notify consumers that the next segment is ready
-    } else {
+    // No lock held while fetching from DB (slow operation). The slot's
+    // segment was consumed, so only stale claims can still touch it.
+    if (buffer->filled.load() < buffer->consumed.load() + ring_size &&
+        !fetch_next(*buffer) && !buffer->missing) {
       // If fetch failed, sleep briefly and retry (in a real system, add
       // backoff)
-      lock.unlock();
       this_thread::sleep_for(chrono::milliseconds(100));
-      lock.lock();
-      // fetch_needed remains true, so it will retry on next loop iteration
+    }
+
+    // One segment per turn, so a busy tag cannot starve the others
+    lock_guard<mutex> lock(mtx);
+    if (!buffer->missing &&
+        buffer->filled.load() < buffer->consumed.load() + ring_size) {
+      fetch_queue.push_back(move(buffer));
+    } else {
+      buffer->queued = false;
     }
   }
 }
 
-uint64_t DualBufferGenerator::next_id() {
+void DualBufferGenerator::sweep_idle_tags() {
+  auto now = chrono::steady_clock::now();
+  unique_lock<shared_mutex> lock(tags_mtx);
+  for (auto it = tags.begin(); it != tags.end();) {
+    SegmentBuffer& buffer = *it->second;
+    if (buffer.used.exchange(false, memory_order_relaxed)) {
+      buffer.last_used = now;
+    }
+    // A missing tag is looked up again on its next request
+    if (buffer.missing || now - buffer.last_used >= tag_idle) {
+      it = tags.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void DualBufferGenerator::request_fetch(
+    const shared_ptr<SegmentBuffer>& buffer) {
+  {
+    lock_guard<mutex> lock(mtx);
+    if (buffer->queued) {
+      return;
+    }
+    buffer->queued = true;
+    fetch_queue.push_back(buffer);
+  }
+  cv_fetch.notify_one();
+}
+
+bool DualBufferGenerator::wait_filled(const SegmentBuffer& buffer,
+                                      uint64_t position) {
+  if (buffer.filled.load(memory_order_acquire) > position) {
+    return true;
+  }
+
+  // The segment is not ready yet! This means the background threads are
+  // too slow or failed. We must wait for them to finish fetching.
   unique_lock<mutex> lock(mtx);
+  cv_consume.wait(lock, [&buffer, position] {
+    return buffer.filled.load() > position || buffer.missing.load();
+  });
+  return buffer.filled.load() > position;
+}
 
-  while (true) {
-    Segment& current_seg = segments[current_pos];
+bool DualBufferGenerator::advance(const shared_ptr<SegmentBuffer>& buffer,
+                                  uint64_t exhausted) {
+  if (!wait_filled(*buffer, exhausted + 1)) {
+    return false;
+  }
 
-    if (current_seg.current_id <= current_seg.max_id) {
-      uint64_t id = current_seg.current_id++;
+  // Whoever wins publishes the next segment; the others just retry
+  uint64_t expected = exhausted;
+  if (buffer->consumed.compare_exchange_strong(expected, exhausted + 1,
+                                               memory_order_acq_rel)) {
+    // How long the exhausted segment lasted steers the next step
+    int64_t now = steady_now_ns();
+    int64_t since = buffer->serving_since.exchange(now, memory_order_relaxed);
+    buffer->last_lifetime.store(now - since, memory_order_relaxed);
+    buffer->lifetimes.fetch_add(1, memory_order_release);
+    request_fetch(buffer);  // Its slot can be refilled
+  }
+  return true;
+}
 
-      // Calculate remaining IDs in the current segment
-      uint64_t remaining = current_seg.max_id - current_seg.current_id + 1;
+shared_ptr<SegmentBuffer> DualBufferGenerator::buffer_for(const string& tag) {
+  if (tag.empty() || tag == DEFAULT_TAG) {
+    return default_buffer;
+  }
 
-      // If less than 20% remaining, trigger background fetch for the next
-      // segment
-      uint64_t threshold = current_seg.step * 0.2;
-      if (remaining <= threshold && !segments[1 - current_pos].is_ready &&
-          !fetch_needed) {
-        fetch_needed = true;
-        cv_fetch.notify_one();
-      }
+  {
+    shared_lock<shared_mutex> lock(tags_mtx);
+    auto found = tags.find(tag);
+    if (found != tags.end()) {
+      return found->second;
+    }
+  }
 
-      return id;
-    } else {
-      // Current segment exhausted, try to swap to the next one
-      int next_pos = 1 - current_pos;
-      if (segments[next_pos].is_ready) {
-        current_seg.is_ready = false;
-        current_pos = next_pos;
-      } else {
-        // Next segment is not ready yet! This means the background thread is
-        // too slow or failed. We must wait for it to finish fetching.
-        if (!fetch_needed) {
-          fetch_needed = true;
-          cv_fetch.notify_one();
+  shared_ptr<SegmentBuffer> buffer;
+  {
+    unique_lock<shared_mutex> lock(tags_mtx);
+    auto found = tags.find(tag);
+    if (found != tags.end()) {
+      return found->second;
+    }
+
+    if (tags.size() >= max_tags) {
+      // Evict the least recently used tag; callers still holding it finish
+      // their batch from it
+      auto oldest = tags.begin();
+      for (auto it = tags.begin(); it != tags.end(); ++it) {
+        if (!it->second->used && (oldest->second->used ||
+                                  it->second->last_used <
+                                      oldest->second->last_used)) {
+          oldest = it;
         }
-        cv_consume.wait(
-            lock, [this, next_pos] { return segments[next_pos].is_ready; });
       }
+      tags.erase(oldest);
+    }
+
+    buffer = make_shared<SegmentBuffer>(tag, ring_size);
+    tags.emplace(tag, buffer);
+  }
+  request_fetch(buffer);
+  return buffer;
+}
+
+uint64_t DualBufferGenerator::next_id() {
+  uint64_t id;
+  return next_ids(&id, 1) == 1 ? id : 0;
+}
+
+size_t DualBufferGenerator::next_ids(uint64_t* out, size_t n) {
+  return take(default_buffer, out, n);
+}
+
+size_t DualBufferGenerator::next_ids_for(const string& tag, uint64_t* out,
+                                         size_t n) {
+  return take(buffer_for(tag), out, n);
+}
+
+size_t DualBufferGenerator::take(const shared_ptr<SegmentBuffer>& buffer,
+                                 uint64_t* out, size_t n) {
+  if (!buffer->used.load(memory_order_relaxed)) {
+    buffer->used.store(true, memory_order_relaxed);
+  }
+
+  size_t count = 0;
+  while (count < n) {
+    uint64_t current = buffer->consumed.load(memory_order_acquire);
+
+    // A new tag's first segment may still be on its way; claiming from the
+    // slot before it is published could hit the fetcher's stores halfway
+    if (buffer->filled.load(memory_order_acquire) <= current) {
+      if (!wait_filled(*buffer, current)) {
+        break;  // The tag has no id_segments row
+      }
+      continue;
+    }
+    Segment& segment = buffer->ring[current % ring_size];
+
+    uint64_t want = n - count;
+    uint64_t first = segment.next_id.fetch_add(want, memory_order_acq_rel);
+    uint64_t max_id = segment.max_id.load(memory_order_acquire);
+
+    // The slot is only refilled after `consumed` moves on; a claim that
+    // may have hit the refill is dropped
+    if (buffer->consumed.load(memory_order_acquire) != current) {
+      continue;
+    }
+
+    if (first > max_id) {
+      if (!advance(buffer, current)) {
+        break;  // The tag has no id_segments row
+      }
+      continue;
+    }
+
+    // Hand out as much of the batch as this segment still holds
+    uint64_t claimed = min(want, max_id - first + 1);
+    for (uint64_t i = 0; i < claimed; ++i) {
+      out[count++] = first + i;
     }
   }
+
+  return count;
 }
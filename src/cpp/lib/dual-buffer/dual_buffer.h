@@ -4,53 +4,161 @@
 #include <mysql/mysql.h>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "../mysql-pool/mysql_pool.h"
 
-struct Segment {
-  uint64_t current_id;
-  uint64_t max_id;
-  uint64_t step;
-  bool is_ready;
-  Segment() : current_id(1), max_id(0), step(1000), is_ready(false) {}
+// IDs next_id..max_id; consumers claim them with fetch_add on next_id, so
+// next_id runs past max_id once the segment is exhausted. Consumers only
+// touch a slot once `filled` says its segment was published.
+struct alignas(64) Segment {
+  std::atomic<uint64_t> next_id{1};
+  std::atomic<uint64_t> max_id{0};
+};
+
+/**
+ * The prefetched segments of one biz_tag.
+ *
+ * Segments are numbered: `consumed` is the one being served, `filled` the
+ * first not yet fetched, and segment k lives in ring[k % ring_size].
+ */
+struct SegmentBuffer {
+  const std::string tag;
+  const size_t ring_size;
+  std::unique_ptr<Segment[]> ring;
+  alignas(64) std::atomic<uint64_t> consumed{0};
+  alignas(64) std::atomic<uint64_t> filled{0};
+
+  // Set by consumers, cleared by the idle sweep
+  alignas(64) std::atomic<bool> used{true};
+
+  // The tag has no id_segments row; consumers give up instead of waiting
+  std::atomic<bool> missing{false};
+
+  // Set by the consumer that moves `consumed` on: when the current segment
+  // started being served, and how long the last exhausted one lasted,
+  // counted by `lifetimes` (steady_clock nanoseconds)
+  alignas(64) std::atomic<int64_t> serving_since{0};
+  std::atomic<int64_t> last_lifetime{0};
+  std::atomic<uint64_t> lifetimes{0};
+
+  // Guarded by the generator's mtx: in the fetch queue or being fetched
+  bool queued = false;
+
+  // Only touched by the fetcher working on this buffer
+  uint64_t min_step = 0;  // The id_segments row's step; 0: not read yet
+  uint64_t step = 0;
+  uint64_t adapted_lifetimes = 0;  // `lifetimes` when `step` was last chosen
+
+  // Guarded by the generator's tags_mtx
+  std::chrono::steady_clock::time_point last_used;
+
+  SegmentBuffer(const std::string& tag, size_t ring_size)
+      : tag(tag), ring_size(ring_size), ring(new Segment[ring_size]),
+        last_used(std::chrono::steady_clock::now()) {}
 };
 
 /**
  * Pre-Generated Blocks & Dual Buffering ID Generator
  *
  * Fetches blocks of IDs from a database to minimize DB hits.
- * Uses a background thread to fetch the next block into a secondary buffer
- * before the primary buffer is exhausted, ensuring low latency.
+ * Uses background threads to fetch the next blocks into a ring of
+ * DUAL_BUFFER_SEGMENTS segments (2 by default) before the current one is
+ * exhausted, ensuring low latency; a deeper ring rides out longer database
+ * stalls.
+ *
+ * Serving an ID takes no lock. A consumer claims IDs with one fetch_add on
+ * the current segment, then checks `consumed` is unchanged, since the slot
+ * is refilled once `consumed` moves on; a stale claim is discarded, leaving
+ * a gap but never a duplicate. The consumer that exhausts a segment moves
+ * `consumed` on with a CAS and queues the buffer for a refill. Only waiting
+ * for a fetch, when the ring is empty, takes `mtx`.
+ *
+ * Every biz_tag in id_segments can be served: next_ids() uses 'default',
+ * next_ids_for() any other tag. A tag's buffer is created on its first
+ * request, which waits for the first segment, and is dropped after
+ * DUAL_BUFFER_TAG_IDLE_MS without requests (its unused IDs become a gap).
+ * At most DUAL_BUFFER_MAX_TAGS buffers are kept, evicting the least
+ * recently used, which bounds prefetched state. DUAL_BUFFER_FETCHERS
+ * threads refill all buffers from one queue, one segment at a time.
+ *
+ * Segments are fetched over a MysqlPool with prepared statements; a failed
+ * connection is reconnected by the pool's health thread, not on the fetch
+ * path.
+ *
+ * The step adapts to demand, as in Leaf: when the tag's last segment was
+ * served for less than SEGMENT_TARGET_MS, from `consumed` moving onto it
+ * until it ran out, the next segment is twice as large (up to
+ * SEGMENT_MAX_STEP), and when it lasted more than twice that it is halved
+ * (down to the step in the id_segments row). Fetches that only prefill the
+ * ring, with no segment run out since the last one, keep the step. The
+ * chosen step is applied in the UPDATE itself, which returns the new max_id
+ * through LAST_INSERT_ID(), so a fetch is a single autocommitted round
+ * trip.
  */
 class DualBufferGenerator : public IdGenerator {
  private:
-  MYSQL* conn;
-  Segment segments[2];
-  int current_pos;
+  size_t ring_size;
+  size_t max_tags;
+  std::chrono::milliseconds tag_idle;
+  std::shared_ptr<SegmentBuffer> default_buffer;
+
+  std::shared_mutex tags_mtx;  // Guards tags
+  std::unordered_map<std::string, std::shared_ptr<SegmentBuffer>> tags;
 
-  std::mutex mtx;                    // Protects buffer state
-  std::mutex db_mtx;                 // Protects DB connection
-  std::condition_variable cv_fetch;  // Wakes up background fetcher
+  std::mutex mtx;  // Guards fetch_queue and queued flags
+  std::deque<std::shared_ptr<SegmentBuffer>> fetch_queue;
+  std::condition_variable cv_fetch;  // Wakes up background fetchers
   std::condition_variable
       cv_consume;  // Wakes up consumers waiting for new segment
 
-  std::thread fetch_thread;
+  std::vector<std::thread> fetch_threads;
   std::atomic<bool> is_running;
-  std::atomic<bool> fetch_needed;
+  std::chrono::steady_clock::time_point next_sweep;  // Guarded by mtx
+
+  LatencyHistogram& fetch_latency;
+  MysqlPool pool;
 
-  void connect();
-  bool fetch_segment(int index);
+  uint64_t max_step;
+  std::chrono::milliseconds target_window;
+  Gauge& step_gauge;  // Of the default tag
+
+  bool read_min_step(SegmentBuffer& buffer);
+  uint64_t choose_step(SegmentBuffer& buffer) const;
+  bool fetch_segment(SegmentBuffer& buffer, Segment& segment);
+  bool fetch_next(SegmentBuffer& buffer);
   void background_fetcher();
+  void sweep_idle_tags();
+  void request_fetch(const std::shared_ptr<SegmentBuffer>& buffer);
+  bool wait_filled(const SegmentBuffer& buffer, uint64_t position);
+  bool advance(const std::shared_ptr<SegmentBuffer>& buffer,
+               uint64_t exhausted);
+  std::shared_ptr<SegmentBuffer> buffer_for(const std::string& tag);
+  size_t take(const std::shared_ptr<SegmentBuffer>& buffer, uint64_t* out,
+              size_t n);
 
  public:
   DualBufferGenerator();
   ~DualBufferGenerator();
 
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
+
+  bool supports_tags() const override { return true; }
+  size_t next_ids_for(const std::string& tag, uint64_t* out,
+                      size_t n) override;
 };
 
 #endif  // DUAL_BUFFER_H
@@ -18,7 +18,8 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
-EtcdSnowflake::EtcdSnowflake() {
+EtcdSnowflake::EtcdSnowflake()
+    : http_latency(backend_latency("etcd_snowflake", "http_post")) {
   const char* etcd_host =
       getenv("ETCD_SERVICE_HOST") ? getenv("ETCD_SERVICE_HOST") : "etcd";
   const char* etcd_port =
@@ -26,7 +27,9 @@ EtcdSnowflake::EtcdSnowflake() {
   etcd_endpoint = string("http://") + etcd_host + ":" + etcd_port + "/v3";
 
   curl_global_init(CURL_GLOBAL_ALL);
-  node_id = claim_node_id();
+  stripes = make_unique<SnowflakeStripes<StandardLayout>>(
+      claim_node_ids(node_id_stripes(StandardLayout::MAX_NODE)),
+      SequenceSlice::of(StandardLayout::SEQUENCE_BITS, 0, 1), "etcd_snowflake");
 
   // Start a background thread to keep the lease alive
   thread([this]() { keep_alive_lease(); }).detach();
@@ -38,6 +41,7 @@ string EtcdSnowflake::http_post(const string& url, const string& data) {
   CURL* curl;
   CURLcode res;
   string readBuffer;
+  ScopedLatency timer(http_latency);
 
   curl = curl_easy_init();
   if (curl) {
@@ -58,7 +62,7 @@ string EtcdSnowflake::http_post(const string& url, const string& data) {
   return readBuffer;
 }
 
-uint64_t EtcdSnowflake::claim_node_id() {
+vector<uint64_t> EtcdSnowflake::claim_node_ids(uint64_t count) {
   // 1. Create a lease with a 10-second TTL
   string lease_url = etcd_endpoint + "/lease/grant";
   string lease_req = R"({"TTL": 10})";
@@ -75,8 +79,10 @@ uint64_t EtcdSnowflake::claim_node_id() {
 
   cout << "Acquired etcd lease: " << lease_id << endl;
 
-  // 2. Try to claim a Node ID from 0 to 1023
-  for (int i = 0; i <= MAX_NODE_ID; ++i) {
+  // 2. Claim the first `count` free Node IDs from 0 to 1023, all under the
+  // one lease
+  vector<uint64_t> claimed;
+  for (uint64_t i = 0; i <= MAX_NODE_ID && claimed.size() < count; ++i) {
     string key = "uuid-generator/node/" + to_string(i);
 
     // Base64 encode key and value (etcd v3 requires base64)
@@ -115,12 +121,17 @@ uint64_t EtcdSnowflake::claim_node_id() {
     // Check if the transaction succeeded
     if (txn_resp.find("\"succeeded\":true") != string::npos) {
       cout << "Successfully claimed Node ID: " << i << endl;
-      return i;
+      claimed.push_back(i);
     }
   }
 
-  throw runtime_error(
-      "Failed to claim any Node ID from etcd (all 1024 IDs in use)");
+  if (claimed.size() < count) {
+    // The claimed keys expire with the lease
+    throw runtime_error("Failed to claim " + to_string(count) +
+                        " Node IDs from etcd (only " +
+                        to_string(claimed.size()) + " of 1024 free)");
+  }
+  return claimed;
 }
 
 void EtcdSnowflake::keep_alive_lease() {
@@ -134,42 +145,8 @@ void EtcdSnowflake::keep_alive_lease() {
   }
 }
 
-uint64_t EtcdSnowflake::current_time_millis() {
-  return chrono::duration_cast<chrono::milliseconds>(
-             chrono::system_clock::now().time_since_epoch())
-      .count();
-}
-
-uint64_t EtcdSnowflake::wait_for_next_millis(uint64_t last_ts) {
-  uint64_t timestamp = current_time_millis();
-  while (timestamp <= last_ts) {
-    timestamp = current_time_millis();
-  }
-  return timestamp;
-}
-
-uint64_t EtcdSnowflake::next_id() {
-  uint64_t timestamp = current_time_millis();
-  uint64_t last_ts = last_timestamp.load();
-
-  if (timestamp < last_ts) {
-    cerr << "Clock moved backwards. Refusing to generate id." << endl;
-    return 0;
-  }
-
-  if (timestamp == last_ts) {
-    uint64_t seq = (sequence.fetch_add(1) + 1) & MAX_SEQUENCE;
-    if (seq == 0) {
-      timestamp = wait_for_next_millis(last_ts);
-    }
-  } else {
-    sequence.store(0);
-  }
-
-  last_timestamp.store(timestamp);
-
-  uint64_t id = ((timestamp - EPOCH) << TIMESTAMP_SHIFT) |
-                (node_id << NODE_ID_SHIFT) | sequence.load();
+uint64_t EtcdSnowflake::next_id() { return stripes->next_id(); }
 
-  return id;
+size_t EtcdSnowflake::next_ids(uint64_t* out, size_t n) {
+  return stripes->next_ids(out, n);
 }
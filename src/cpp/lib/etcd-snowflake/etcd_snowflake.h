@@ -1,32 +1,36 @@
 #ifndef ETCD_SNOWFLAKE_H
 #define ETCD_SNOWFLAKE_H
 
-#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "../snowflake/snowflake_stripes.h"
+#include "../snowflake_layout.h"
 
 class EtcdSnowflake : public IdGenerator {
  private:
-  uint64_t node_id;
-  std::atomic<uint64_t> sequence{0};
-  std::atomic<uint64_t> last_timestamp{0};
+  // Created once the node IDs (NODE_ID_STRIPES of them) have been claimed
+  std::unique_ptr<SnowflakeStripes<StandardLayout>> stripes;
+
+  LatencyHistogram& http_latency;
+
   std::string etcd_endpoint;
   std::string lease_id;
 
-  uint64_t current_time_millis();
-  uint64_t wait_for_next_millis(uint64_t last_ts);
-
   // Etcd communication methods
   std::string http_post(const std::string& url, const std::string& data);
-  uint64_t claim_node_id();
+  std::vector<uint64_t> claim_node_ids(uint64_t count);
   void keep_alive_lease();
 
  public:
   EtcdSnowflake();
   ~EtcdSnowflake();
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
 };
 
 #endif  // ETCD_SNOWFLAKE_H
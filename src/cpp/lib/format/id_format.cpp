@@ -0,0 +1,128 @@
+#include "id_format.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ID_FORMAT_X86 1
+#endif
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Copies 32 hex digits into the 8-4-4-4-12 layout
+static inline void place_dashes(const char* hex, char* out) {
+  memcpy(out, hex, 8);
+  out[8] = '-';
+  memcpy(out + 9, hex + 8, 4);
+  out[13] = '-';
+  memcpy(out + 14, hex + 12, 4);
+  out[18] = '-';
+  memcpy(out + 19, hex + 16, 4);
+  out[23] = '-';
+  memcpy(out + 24, hex + 20, 12);
+}
+
+void format_uuid_scalar(const Uuid128& id, char* out) {
+  char hex[32];
+  for (int i = 0; i < 16; ++i) {
+    hex[i] = HEX_DIGITS[(id.hi >> (60 - 4 * i)) & 0xF];
+    hex[16 + i] = HEX_DIGITS[(id.lo >> (60 - 4 * i)) & 0xF];
+  }
+  place_dashes(hex, out);
+}
+
+#ifdef ID_FORMAT_X86
+
+// The 16 UUID bytes in RFC 4122 order, split into high and low nibbles and
+// interleaved: `first` holds hex digits 0-15, `second` digits 16-31
+static inline void split_nibbles(const Uuid128& id, __m128i* first,
+                                 __m128i* second) {
+  __m128i bytes =
+      _mm_set_epi64x(static_cast<long long>(__builtin_bswap64(id.lo)),
+                     static_cast<long long>(__builtin_bswap64(id.hi)));
+  __m128i mask = _mm_set1_epi8(0x0F);
+  __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+  __m128i low = _mm_and_si128(bytes, mask);
+  *first = _mm_unpacklo_epi8(high, low);
+  *second = _mm_unpackhi_epi8(high, low);
+}
+
+#ifdef __SSE2__
+// SSE2 has no byte shuffle, so digits are '0' + n, plus the distance to
+// 'a' where n > 9
+static inline __m128i nibbles_to_hex_sse2(__m128i n) {
+  __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+                                  _mm_set1_epi8('a' - '0' - 10));
+  return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+}
+
+static void format_uuid_sse2(const Uuid128& id, char* out) {
+  __m128i first;
+  __m128i second;
+  split_nibbles(id, &first, &second);
+
+  char hex[32];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex), nibbles_to_hex_sse2(first));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 16),
+                   nibbles_to_hex_sse2(second));
+  place_dashes(hex, out);
+}
+#endif  // __SSE2__
+
+// AVX2 looks all 32 digits up in one vpshufb
+__attribute__((target("avx2"))) static void format_uuid_avx2(
+    const Uuid128& id, char* out) {
+  __m128i first;
+  __m128i second;
+  split_nibbles(id, &first, &second);
+
+  const __m256i table = _mm256_setr_epi8(
+      '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd',
+      'e', 'f', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b',
+      'c', 'd', 'e', 'f');
+  __m256i nibbles = _mm256_set_m128i(second, first);
+
+  char hex[32];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(hex),
+                      _mm256_shuffle_epi8(table, nibbles));
+  place_dashes(hex, out);
+}
+
+#endif  // ID_FORMAT_X86
+
+typedef void (*UuidKernel)(const Uuid128&, char*);
+
+struct KernelChoice {
+  UuidKernel kernel;
+  const char* name;
+};
+
+static KernelChoice pick_kernel() {
+#ifdef ID_FORMAT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {format_uuid_avx2, "avx2"};
+  }
+#ifdef __SSE2__
+  return {format_uuid_sse2, "sse2"};
+#endif
+#endif
+  return {format_uuid_scalar, "scalar"};
+}
+
+// Picked once, at static initialisation
+static const KernelChoice uuid_kernel = pick_kernel();
+
+void format_uuid(const Uuid128& id, char* out) { uuid_kernel.kernel(id, out); }
+
+size_t format_uuid_batch(const Uuid128* ids, size_t n, char separator,
+                         char* out) {
+  UuidKernel kernel = uuid_kernel.kernel;
+  char* p = out;
+  for (size_t i = 0; i < n; ++i) {
+    kernel(ids[i], p);
+    p[UUID_TEXT_SIZE] = separator;
+    p += UUID_TEXT_SIZE + 1;
+  }
+  return p - out;
+}
+
+const char* uuid_format_kernel() { return uuid_kernel.name; }
@@ -0,0 +1,129 @@
+#ifndef ID_FORMAT_H
+#define ID_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "../uuid128.h"
+
+/**
+ * Text formatting for IDs, writing into caller-provided buffers.
+ *
+ * Nothing here allocates except the std::string convenience wrappers.
+ * Batch functions write a whole batch into one contiguous span so a
+ * transport can format thousands of IDs straight into its send buffer.
+ */
+
+// Longest decimal form of a uint64_t
+const size_t DECIMAL_MAX_SIZE = 20;
+
+// Length of the 8-4-4-4-12 UUID form
+const size_t UUID_TEXT_SIZE = Uuid128::TEXT_SIZE;
+
+// "00" "01" ... "99": two digits per lookup halves the divisions
+inline constexpr char DECIMAL_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+inline size_t decimal_length(uint64_t v) {
+  // Powers of ten below each bit width; one compare corrects the estimate
+  static const uint64_t POW10[] = {0ULL,
+                                   10ULL,
+                                   100ULL,
+                                   1000ULL,
+                                   10000ULL,
+                                   100000ULL,
+                                   1000000ULL,
+                                   10000000ULL,
+                                   100000000ULL,
+                                   1000000000ULL,
+                                   10000000000ULL,
+                                   100000000000ULL,
+                                   1000000000000ULL,
+                                   10000000000000ULL,
+                                   100000000000000ULL,
+                                   1000000000000000ULL,
+                                   10000000000000000ULL,
+                                   100000000000000000ULL,
+                                   1000000000000000000ULL,
+                                   10000000000000000000ULL};
+  // floor(log10(2^bits)) + 1 ~= bits * 1233 / 4096 + 1
+  int bits = 64 - __builtin_clzll(v | 1);
+  size_t len = (bits * 1233) >> 12;
+  return len + 1 - (v < POW10[len]);
+}
+
+/**
+ * Writes the decimal digits of v to out (at least DECIMAL_MAX_SIZE bytes).
+ * @return The number of bytes written.
+ */
+inline size_t format_decimal(uint64_t v, char* out) {
+  size_t len = decimal_length(v);
+  char* p = out + len;
+  while (v >= 100) {
+    const char* pair = &DECIMAL_PAIRS[(v % 100) * 2];
+    v /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if (v >= 10) {
+    *--p = DECIMAL_PAIRS[v * 2 + 1];
+    *--p = DECIMAL_PAIRS[v * 2];
+  } else {
+    *--p = static_cast<char>('0' + v);
+  }
+  return len;
+}
+
+/**
+ * Writes n IDs in decimal, each followed by `separator`, to out (at least
+ * n * (DECIMAL_MAX_SIZE + 1) bytes).
+ * @return The number of bytes written.
+ */
+inline size_t format_decimal_batch(const uint64_t* ids, size_t n,
+                                   char separator, char* out) {
+  char* p = out;
+  for (size_t i = 0; i < n; ++i) {
+    p += format_decimal(ids[i], p);
+    *p++ = separator;
+  }
+  return p - out;
+}
+
+/**
+ * Writes the lower-case 8-4-4-4-12 form of id to out (UUID_TEXT_SIZE
+ * bytes, no terminator). Uses AVX2 or SSE2 where the CPU has them; the
+ * portable version gives identical output.
+ */
+void format_uuid(const Uuid128& id, char* out);
+
+// Portable version of format_uuid()
+void format_uuid_scalar(const Uuid128& id, char* out);
+
+/**
+ * Writes n UUIDs, each followed by `separator`, to out (n *
+ * (UUID_TEXT_SIZE + 1) bytes).
+ * @return The number of bytes written.
+ */
+size_t format_uuid_batch(const Uuid128* ids, size_t n, char separator,
+                         char* out);
+
+// Name of the UUID kernel picked for this CPU ("avx2", "sse2" or "scalar")
+const char* uuid_format_kernel();
+
+inline std::string uuid_to_string(const Uuid128& id) {
+  std::string s(UUID_TEXT_SIZE, '\0');
+  format_uuid(id, &s[0]);
+  return s;
+}
+
+inline std::string decimal_to_string(uint64_t v) {
+  char digits[DECIMAL_MAX_SIZE];
+  return std::string(digits, format_decimal(v, digits));
+}
+
+#endif  // ID_FORMAT_H
@@ -1,31 +1,81 @@
 #include "hlc_snowflake.h"
 
-#include <chrono>
+#include <cstdlib>
 
 #include "../network_util.h"
 
 using namespace std;
 
-HlcSnowflake::HlcSnowflake() : node_id(get_node_id_from_ip() & MAX_NODE_ID) {
+namespace {
+
+// Block of sequence numbers leased by the calling thread
+struct HlcLease {
+  uint64_t owner = 0;  // instance_id of the generator; 0 = none
+  uint64_t pt = 0;
+  uint64_t next_seq = 0;
+  uint64_t end_seq = 0;  // One past the last leased sequence number
+};
+
+thread_local HlcLease current_lease;
+atomic<uint64_t> next_instance_id{1};
+
+}  // namespace
+
+HlcSnowflake::HlcSnowflake(uint64_t slice_index, uint64_t slice_count,
+                           ClockSource& clock)
+    : node_id(get_node_id_from_ip() & MAX_NODE_ID),
+      sequence_slice(
+          SequenceSlice::of(SEQUENCE_BITS, slice_index, slice_count)),
+      lease_size(getenv("HLC_LEASE_SIZE")
+                     ? strtoull(getenv("HLC_LEASE_SIZE"), nullptr, 10)
+                     : 0),
+      instance_id(next_instance_id.fetch_add(1)),
+      clock(clock),
+      checkpoint(process_checkpoint()),
+      cas_retries(cas_retries_counter("hlc_snowflake")),
+      sequence_exhausted(sequence_exhausted_counter("hlc_snowflake")) {
+  // A lease can never exceed this instance's slice of a millisecond
+  if (lease_size > sequence_slice.mask + 1) {
+    lease_size = sequence_slice.mask + 1;
+  }
+
   // Initialize state with current time
   uint64_t pt = current_time_millis();
   state.store(pt << SEQUENCE_BITS);
+
+  if (checkpoint) {
+    // The floor's millisecond may hold IDs from before the restart: mark it
+    // used, so logical time continues after it
+    uint64_t floor = checkpoint->floor_millis();
+    if (floor >= pt) {
+      state.store((floor << SEQUENCE_BITS) | MAX_SEQUENCE);
+    }
+    checkpoint_source = checkpoint->add_source(
+        [this] { return state.load(memory_order_relaxed) >> SEQUENCE_BITS; });
+  }
 }
 
-uint64_t HlcSnowflake::current_time_millis() {
-  return chrono::duration_cast<chrono::milliseconds>(
-             chrono::system_clock::now().time_since_epoch())
-      .count();
+HlcSnowflake::~HlcSnowflake() {
+  if (checkpoint) {
+    checkpoint->remove_source(checkpoint_source);
+  }
 }
 
-uint64_t HlcSnowflake::next_id() {
+uint64_t HlcSnowflake::reserve(uint64_t count, uint64_t* pt_out,
+                               uint64_t* seq_out) {
   uint64_t current_state = state.load();
   uint64_t next_state;
   uint64_t next_pt;
-  uint64_t next_seq;
+  uint64_t first_seq;
+  uint64_t reserved;
+  uint64_t attempts = 0;
+  bool overflowed;
 
   // Lock-free Compare-And-Swap (CAS) loop
   do {
+    ++attempts;
+    overflowed = false;
+
     // Unpack current logical timestamp and sequence
     uint64_t last_pt = current_state >> SEQUENCE_BITS;
     uint64_t seq = current_state & MAX_SEQUENCE;
@@ -36,31 +86,94 @@ uint64_t HlcSnowflake::next_id() {
     if (pt > last_pt) {
       // Physical time advanced normally: update timestamp, reset sequence
       next_pt = pt;
-      next_seq = 0;
+      first_seq = 0;
     } else {
       // Physical time is the same or moved backwards (clock skew):
       // Ignore physical time, increment sequence instead
       next_pt = last_pt;
-      next_seq = seq + 1;
+      first_seq = seq + 1;
 
-      // If sequence overflows (e.g., > 4095), artificially advance logical time
-      if (next_seq > MAX_SEQUENCE) {
+      // If sequence overflows (e.g., > 4095, or the end of this instance's
+      // slice), artificially advance logical time
+      if (first_seq > sequence_slice.mask) {
         next_pt++;
-        next_seq = 0;
+        first_seq = 0;
+        overflowed = true;
       }
     }
 
-    // Pack the new logical timestamp and sequence into the state
-    next_state = (next_pt << SEQUENCE_BITS) | next_seq;
+    // Take as much of the run as is left in this logical millisecond
+    reserved = sequence_slice.mask - first_seq + 1;
+    if (reserved > count) {
+      reserved = count;
+    }
+
+    // Pack the new logical timestamp and last reserved sequence into the state
+    next_state = (next_pt << SEQUENCE_BITS) | (first_seq + reserved - 1);
 
     // Attempt to atomically update the state. If another thread beat us to it,
     // current_state is updated with the new value, and we loop again.
   } while (!state.compare_exchange_weak(current_state, next_state));
 
+  if (attempts > 1) {
+    cas_retries.inc(attempts - 1);
+  }
+  if (overflowed) {
+    sequence_exhausted.inc();
+  }
+
+  *pt_out = next_pt;
+  *seq_out = first_seq;
+  return reserved;
+}
+
+uint64_t HlcSnowflake::compose(uint64_t pt, uint64_t seq) const {
   // Pack the logical timestamp, node ID, and sequence into a 64-bit integer
   // Layout: [1 bit unused] - [41 bits time] - [10 bits node] - [12 bits seq]
-  uint64_t id = ((next_pt - EPOCH) << TIMESTAMP_SHIFT) |
-                (node_id << NODE_ID_SHIFT) | next_seq;
+  return StandardLayout::pack(pt, node_id, sequence_slice.base + seq);
+}
+
+uint64_t HlcSnowflake::next_leased_id() {
+  HlcLease& lease = current_lease;
+
+  // Serve from the thread's block while its millisecond is not in the past
+  if (lease.owner == instance_id && lease.next_seq < lease.end_seq &&
+      current_time_millis() <= lease.pt) {
+    return compose(lease.pt, lease.next_seq++);
+  }
+
+  // Lease a new block; whatever remains of the old one is dropped
+  uint64_t pt;
+  uint64_t seq;
+  uint64_t reserved = reserve(lease_size, &pt, &seq);
+  lease.owner = instance_id;
+  lease.pt = pt;
+  lease.next_seq = seq + 1;
+  lease.end_seq = seq + reserved;
+  return compose(pt, seq);
+}
+
+uint64_t HlcSnowflake::next_id() {
+  if (lease_size > 1) {
+    return next_leased_id();
+  }
 
-  return id;
+  uint64_t pt;
+  uint64_t seq;
+  reserve(1, &pt, &seq);
+  return compose(pt, seq);
+}
+
+size_t HlcSnowflake::next_ids(uint64_t* out, size_t n) {
+  size_t filled = 0;
+  while (filled < n) {
+    // One CAS per logical millisecond the batch spans
+    uint64_t pt;
+    uint64_t seq;
+    uint64_t reserved = reserve(n - filled, &pt, &seq);
+    for (uint64_t i = 0; i < reserved; ++i) {
+      out[filled++] = compose(pt, seq + i);
+    }
+  }
+  return n;
 }
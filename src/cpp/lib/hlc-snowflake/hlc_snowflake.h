@@ -4,20 +4,63 @@
 #include <atomic>
 #include <cstdint>
 
+#include "../checkpoint/timestamp_checkpoint.h"
+#include "../clock/clock_source.h"
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "../snowflake_layout.h"
 
+/**
+ * Hybrid Logical Clock Snowflake: when the clock stalls, moves backwards or
+ * a millisecond's sequence runs out, logical time advances instead of
+ * failing.
+ *
+ * With HLC_LEASE_SIZE > 1 each thread claims a block of that many sequence
+ * numbers with one CAS and hands them out locally, so the shared state is
+ * touched once per block instead of once per ID. A thread drops the rest of
+ * its block once the clock passes the block's millisecond, so its IDs never
+ * lag the clock by more than 1 ms. IDs from one thread stay increasing, but
+ * IDs from different threads interleave within a millisecond. Dropped
+ * numbers are never reissued; they cost sequence space, so keep
+ * lease size x threads well below the 4096 IDs per millisecond.
+ *
+ * With a process checkpoint open (CHECKPOINT_PATH), logical time starts
+ * after the restored floor, so IDs borrowed ahead of the clock before a
+ * restart are not issued again.
+ */
 class HlcSnowflake : public IdGenerator {
  private:
-  uint64_t node_id;
   // state packs the 41-bit timestamp and 12-bit sequence into a single 64-bit
-  // atomic
-  std::atomic<uint64_t> state{0};
+  // atomic, alone on its cache line
+  alignas(64) std::atomic<uint64_t> state{0};
 
-  uint64_t current_time_millis();
+  alignas(64) uint64_t node_id;
+  SequenceSlice sequence_slice;
+  uint64_t lease_size;   // Sequence numbers per thread lease (<= 1: off)
+  uint64_t instance_id;  // Tells this instance's leases from others'
+  ClockSource& clock;
+  TimestampCheckpoint* checkpoint;
+  uint64_t checkpoint_source = 0;
+
+  Counter& cas_retries;
+  Counter& sequence_exhausted;
+
+  uint64_t current_time_millis() { return clock.now_millis(); }
+
+  // Claims up to `count` consecutive sequence numbers of one logical
+  // millisecond with a single CAS and returns how many were claimed
+  uint64_t reserve(uint64_t count, uint64_t* pt_out, uint64_t* seq_out);
+  uint64_t compose(uint64_t pt, uint64_t seq) const;
+  uint64_t next_leased_id();
 
  public:
-  HlcSnowflake();
+  // slice_index/slice_count give this instance its own part of the sequence
+  // space when several instances share a node ID (one per worker thread)
+  explicit HlcSnowflake(uint64_t slice_index = 0, uint64_t slice_count = 1,
+                        ClockSource& clock = default_clock_source());
+  ~HlcSnowflake();
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
 };
 
 #endif  // HLC_SNOWFLAKE_H
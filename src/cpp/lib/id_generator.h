@@ -1,9 +1,14 @@
 #ifndef ID_GENERATOR_H
 #define ID_GENERATOR_H
 
+#include <cstddef>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
 
+#include "format/id_format.h"
+#include "uuid128.h"
+
 // ---------------------------------------------------------
 // Shared Parameters for 64-bit ID Generators
 // ---------------------------------------------------------
@@ -19,6 +24,48 @@ const uint64_t MAX_SEQUENCE = (static_cast<uint64_t>(1) << SEQUENCE_BITS) - 1;
 const uint64_t NODE_ID_SHIFT = SEQUENCE_BITS;
 const uint64_t TIMESTAMP_SHIFT = SEQUENCE_BITS + NODE_ID_BITS;
 
+/**
+ * A contiguous, power-of-two sized slice of the per-tick sequence space.
+ *
+ * Several generator instances that share one node ID (e.g. one per server
+ * worker thread) each own a different slice, so they never contend on the
+ * same atomic and never hand out the same sequence number. The default
+ * slice (index 0 of 1) is the whole sequence space.
+ */
+struct SequenceSlice {
+  uint64_t base;  // First sequence number of the slice
+  uint64_t mask;  // Slice size - 1
+
+  /**
+   * @param sequence_bits Width of the generator's sequence field
+   * @param index Which slice this instance owns (0 <= index < count)
+   * @param count Number of instances; rounded up to a power of two
+   * @throws std::invalid_argument if there are more instances than
+   * sequence numbers
+   */
+  static SequenceSlice of(uint64_t sequence_bits, uint64_t index,
+                          uint64_t count) {
+    if (index >= count || count > (static_cast<uint64_t>(1) << sequence_bits)) {
+      throw std::invalid_argument("Sequence space too small for " +
+                                  std::to_string(count) + " slices");
+    }
+    uint64_t slice_bits = sequence_bits;
+    while (slice_bits > 0 && (static_cast<uint64_t>(1)
+                              << (sequence_bits - slice_bits)) < count) {
+      --slice_bits;
+    }
+    return {index << slice_bits,
+            (static_cast<uint64_t>(1) << slice_bits) - 1};
+  }
+};
+
+// Shape of the IDs a generator produces natively
+enum class IdKind {
+  INT64,    // next_id() is the ID; next_id_string() is its decimal form
+  UUID128,  // next_id128() is the ID; next_id_string() is its hex form
+  TEXT,     // next_id_string() is an opaque string
+};
+
 /**
  * Base interface for all ID generators.
  */
@@ -30,7 +77,64 @@ class IdGenerator {
   virtual uint64_t next_id() { return 0; }
 
   // Returns the ID as a formatted string (used for IPC)
-  virtual std::string next_id_string() { return std::to_string(next_id()); }
+  virtual std::string next_id_string() { return decimal_to_string(next_id()); }
+
+  // Tells transports which wire formats this generator can serve
+  virtual IdKind kind() const { return IdKind::INT64; }
+
+  /**
+   * Writes up to n 64-bit IDs to `out`. Generators override this to
+   * reserve the whole batch at once (one CAS, one lock, one round trip).
+   *
+   * @return The number of IDs written; fewer than n means the generator
+   * failed after that many (the same condition next_id() reports with 0).
+   */
+  virtual size_t next_ids(uint64_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = next_id();
+      if (out[i] == 0) return i;
+    }
+    return n;
+  }
+
+  // Whether next_ids_for() serves sequences other than the default one
+  virtual bool supports_tags() const { return false; }
+
+  /**
+   * next_ids() from the sequence named `tag` (e.g. a business tag), for
+   * generators that keep several. The empty tag is the default sequence.
+   *
+   * @return The number of IDs written; 0 for an unknown tag.
+   */
+  virtual size_t next_ids_for(const std::string& tag, uint64_t* out,
+                              size_t n) {
+    return tag.empty() ? next_ids(out, n) : 0;
+  }
+
+  /**
+   * Returns the ID as a 128-bit value (UUID128 generators). The default
+   * parses next_id_string(); failures give the nil UUID.
+   */
+  virtual Uuid128 next_id128() {
+    Uuid128 id = {0, 0};
+    if (kind() != IdKind::UUID128 || !Uuid128::parse(next_id_string(), &id)) {
+      return {0, 0};
+    }
+    return id;
+  }
+
+  /**
+   * 128-bit counterpart of next_ids() for UUID128 generators.
+   *
+   * @return The number of IDs written (0 for other kinds of generator).
+   */
+  virtual size_t next_ids128(Uuid128* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = next_id128();
+      if (out[i].is_nil()) return i;
+    }
+    return n;
+  }
 };
 
 #endif  // ID_GENERATOR_H
@@ -1,36 +1,26 @@
 #ifndef INSTA_SNOWFLAKE_H
 #define INSTA_SNOWFLAKE_H
 
-#include <atomic>
 #include <cstdint>
 
+#include "../clock/clock_source.h"
 #include "../id_generator.h"
+#include "../snowflake/snowflake_stripes.h"
+#include "../snowflake_layout.h"
 
-// Instagram specific parameters
-const uint64_t INSTA_SHARD_ID_BITS = 13;
-const uint64_t INSTA_SEQUENCE_BITS = 10;
-
-const uint64_t MAX_INSTA_SHARD_ID =
-    (static_cast<uint64_t>(1) << INSTA_SHARD_ID_BITS) - 1;
-const uint64_t MAX_INSTA_SEQUENCE =
-    (static_cast<uint64_t>(1) << INSTA_SEQUENCE_BITS) - 1;
-
-const uint64_t INSTA_SHARD_ID_SHIFT = INSTA_SEQUENCE_BITS;
-const uint64_t INSTA_TIMESTAMP_SHIFT =
-    INSTA_SEQUENCE_BITS + INSTA_SHARD_ID_BITS;
-
+// Instagram layout: 13-bit shard ID, 10-bit sequence (see InstaLayout)
 class InstaSnowflake : public IdGenerator {
  private:
-  uint64_t shard_id;
-  std::atomic<uint64_t> sequence{0};
-  std::atomic<uint64_t> last_timestamp{0};
-
-  uint64_t current_time_millis();
-  uint64_t wait_for_next_millis(uint64_t last_ts);
+  SnowflakeStripes<InstaLayout> stripes;
 
  public:
-  InstaSnowflake();
+  // slice_index/slice_count give this instance its own part of the sequence
+  // space when several instances share a node ID (one per worker thread).
+  // NODE_ID_STRIPES sets how many node IDs the instance owns.
+  explicit InstaSnowflake(uint64_t slice_index = 0, uint64_t slice_count = 1,
+                          ClockSource& clock = default_clock_source());
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
 };
 
 #endif  // INSTA_SNOWFLAKE_H
@@ -0,0 +1,77 @@
+#ifndef INSTRUMENTED_GENERATOR_H
+#define INSTRUMENTED_GENERATOR_H
+
+#include <string>
+
+#include "../id_generator.h"
+#include "metrics.h"
+
+/**
+ * Decorator that records the latency of every call into the wrapped
+ * generator. main() only wraps generators when metrics are enabled, so the
+ * unwrapped path pays nothing.
+ */
+class InstrumentedGenerator : public IdGenerator {
+ private:
+  IdGenerator& inner;
+  LatencyHistogram& next_id_latency;
+  LatencyHistogram& next_id_string_latency;
+  LatencyHistogram& next_id128_latency;
+  LatencyHistogram& next_ids_latency;
+  LatencyHistogram& next_ids128_latency;
+
+  static LatencyHistogram& call_latency(const std::string& generator,
+                                        const char* method) {
+    return MetricsRegistry::instance().histogram(
+        "id_generator_call_duration_seconds",
+        "Latency of IdGenerator calls made by the sidecar.",
+        "generator=\"" + generator + "\",method=\"" + method + "\"");
+  }
+
+ public:
+  // `generator` is the label value, e.g. the lower-case GENERATOR_TYPE
+  InstrumentedGenerator(IdGenerator& inner, const std::string& generator)
+      : inner(inner),
+        next_id_latency(call_latency(generator, "next_id")),
+        next_id_string_latency(call_latency(generator, "next_id_string")),
+        next_id128_latency(call_latency(generator, "next_id128")),
+        next_ids_latency(call_latency(generator, "next_ids")),
+        next_ids128_latency(call_latency(generator, "next_ids128")) {}
+
+  uint64_t next_id() override {
+    ScopedLatency timer(next_id_latency);
+    return inner.next_id();
+  }
+
+  std::string next_id_string() override {
+    ScopedLatency timer(next_id_string_latency);
+    return inner.next_id_string();
+  }
+
+  Uuid128 next_id128() override {
+    ScopedLatency timer(next_id128_latency);
+    return inner.next_id128();
+  }
+
+  // Batch calls are timed per call, not per ID
+  size_t next_ids(uint64_t* out, size_t n) override {
+    ScopedLatency timer(next_ids_latency);
+    return inner.next_ids(out, n);
+  }
+
+  size_t next_ids_for(const std::string& tag, uint64_t* out,
+                      size_t n) override {
+    ScopedLatency timer(next_ids_latency);
+    return inner.next_ids_for(tag, out, n);
+  }
+
+  size_t next_ids128(Uuid128* out, size_t n) override {
+    ScopedLatency timer(next_ids128_latency);
+    return inner.next_ids128(out, n);
+  }
+
+  IdKind kind() const override { return inner.kind(); }
+  bool supports_tags() const override { return inner.supports_tags(); }
+};
+
+#endif  // INSTRUMENTED_GENERATOR_H
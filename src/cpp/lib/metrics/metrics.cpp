@@ -0,0 +1,237 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+bool metrics_enabled = false;
+
+// Threads take stripes round-robin as they first record
+static atomic<unsigned> next_stripe{0};
+
+void LatencyHistogram::record_ns(uint64_t ns) {
+  static thread_local unsigned stripe_index =
+      next_stripe.fetch_add(1, memory_order_relaxed);
+  Stripe& stripe = stripes[stripe_index % STRIPES];
+
+  int bucket;
+  if (ns < (static_cast<uint64_t>(1) << MIN_EXPONENT)) {
+    bucket = 0;
+  } else {
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent >= MAX_EXPONENT) {
+      bucket = BUCKETS - 1;
+    } else {
+      // Second half of the octave if the bit below the top one is set
+      int upper_half = (ns >> (exponent - 1)) & 1;
+      bucket = 1 + (exponent - MIN_EXPONENT) * 2 + upper_half;
+    }
+  }
+
+  stripe.buckets[bucket].fetch_add(1, memory_order_relaxed);
+  stripe.sum_ns.fetch_add(ns, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucket_bound_ns(int i) {
+  if (i == 0) {
+    return (static_cast<uint64_t>(1) << MIN_EXPONENT) - 1;
+  }
+  int exponent = MIN_EXPONENT + (i - 1) / 2;
+  uint64_t base = static_cast<uint64_t>(1) << exponent;
+  return (i - 1) % 2 == 0 ? base + base / 2 - 1 : 2 * base - 1;
+}
+
+void LatencyHistogram::snapshot(uint64_t* counts, uint64_t* sum_ns) const {
+  *sum_ns = 0;
+  for (int i = 0; i < BUCKETS; ++i) counts[i] = 0;
+
+  for (const Stripe& stripe : stripes) {
+    for (int i = 0; i < BUCKETS; ++i) {
+      counts[i] += stripe.buckets[i].load(memory_order_relaxed);
+    }
+    *sum_ns += stripe.sum_ns.load(memory_order_relaxed);
+  }
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::Series* MetricsRegistry::find(const string& name,
+                                               const string& labels) {
+  for (Series& s : series) {
+    if (s.name == name && s.labels == labels) return &s;
+  }
+  return nullptr;
+}
+
+Counter& MetricsRegistry::counter(const string& name, const string& help,
+                                  const string& labels) {
+  lock_guard<mutex> lock(mtx);
+  if (Series* s = find(name, labels)) {
+    return *s->counter;
+  }
+  series.push_back(
+      {name, help, labels, make_unique<Counter>(), nullptr, nullptr});
+  return *series.back().counter;
+}
+
+Gauge& MetricsRegistry::gauge(const string& name, const string& help,
+                              const string& labels) {
+  lock_guard<mutex> lock(mtx);
+  if (Series* s = find(name, labels)) {
+    return *s->gauge;
+  }
+  series.push_back(
+      {name, help, labels, nullptr, make_unique<Gauge>(), nullptr});
+  return *series.back().gauge;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const string& name,
+                                             const string& help,
+                                             const string& labels) {
+  lock_guard<mutex> lock(mtx);
+  if (Series* s = find(name, labels)) {
+    return *s->histogram;
+  }
+  series.push_back(
+      {name, help, labels, nullptr, nullptr, make_unique<LatencyHistogram>()});
+  return *series.back().histogram;
+}
+
+// Formats nanoseconds as seconds, as Prometheus expects
+static string seconds(uint64_t ns) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", ns / 1e9);
+  return buf;
+}
+
+string MetricsRegistry::render() const {
+  lock_guard<mutex> lock(mtx);
+  ostringstream out;
+
+  vector<bool> rendered(series.size(), false);
+  for (size_t i = 0; i < series.size(); ++i) {
+    if (rendered[i]) continue;
+    const Series& first = series[i];
+    out << "# HELP " << first.name << " " << first.help << "\n";
+    out << "# TYPE " << first.name << " "
+        << (first.counter ? "counter" : first.gauge ? "gauge" : "histogram")
+        << "\n";
+
+    // All series sharing a name are rendered under one HELP/TYPE header
+    for (size_t j = i; j < series.size(); ++j) {
+      const Series& s = series[j];
+      if (s.name != first.name) continue;
+      rendered[j] = true;
+
+      if (s.counter || s.gauge) {
+        out << s.name;
+        if (!s.labels.empty()) out << "{" << s.labels << "}";
+        if (s.counter) {
+          out << " " << s.counter->get() << "\n";
+        } else {
+          out << " " << s.gauge->get() << "\n";
+        }
+        continue;
+      }
+
+      uint64_t counts[LatencyHistogram::BUCKETS];
+      uint64_t sum_ns;
+      s.histogram->snapshot(counts, &sum_ns);
+      string prefix = s.labels.empty() ? "" : s.labels + ",";
+
+      uint64_t cumulative = 0;
+      for (int b = 0; b < LatencyHistogram::BUCKETS; ++b) {
+        cumulative += counts[b];
+        bool last = b == LatencyHistogram::BUCKETS - 1;
+        out << s.name << "_bucket{" << prefix << "le=\""
+            << (last ? "+Inf"
+                     : seconds(LatencyHistogram::bucket_bound_ns(b) + 1))
+            << "\"} " << cumulative << "\n";
+      }
+      string labels = s.labels.empty() ? "" : "{" + s.labels + "}";
+      out << s.name << "_sum" << labels << " " << seconds(sum_ns) << "\n";
+      out << s.name << "_count" << labels << " " << cumulative << "\n";
+    }
+  }
+
+  return out.str();
+}
+
+static Counter& generator_counter(const char* name, const char* help,
+                                  const char* generator) {
+  return MetricsRegistry::instance().counter(
+      name, help, string("generator=\"") + generator + "\"");
+}
+
+Counter& cas_retries_counter(const char* generator) {
+  return generator_counter(
+      "id_generator_cas_retries_total",
+      "Compare-and-swap retries caused by contention on generator state.",
+      generator);
+}
+
+Counter& sequence_exhausted_counter(const char* generator) {
+  return generator_counter(
+      "id_generator_sequence_exhausted_total",
+      "Times a tick ran out of sequence numbers (the generator waited for "
+      "the next tick, or HLC advanced its logical clock).",
+      generator);
+}
+
+Counter& clock_backwards_counter(const char* generator) {
+  return generator_counter(
+      "id_generator_clock_backwards_total",
+      "IDs refused because the system clock moved backwards.", generator);
+}
+
+LatencyHistogram& sequence_wait_latency(const char* generator) {
+  return MetricsRegistry::instance().histogram(
+      "id_generator_sequence_wait_duration_seconds",
+      "Time callers were blocked waiting for the next tick after its "
+      "sequence numbers ran out.",
+      string("generator=\"") + generator + "\"");
+}
+
+Gauge& clock_skew_gauge(const char* generator) {
+  return MetricsRegistry::instance().gauge(
+      "id_generator_clock_skew_milliseconds",
+      "How far the time in the last issued ID is ahead of the clock, while "
+      "generation rides through a clock step backwards.",
+      string("generator=\"") + generator + "\"");
+}
+
+Gauge& segment_step_gauge(const char* generator) {
+  return MetricsRegistry::instance().gauge(
+      "id_generator_segment_step",
+      "Number of IDs requested in the last segment fetched from the "
+      "database.",
+      string("generator=\"") + generator + "\"");
+}
+
+LatencyHistogram& backend_latency(const char* generator,
+                                  const char* operation) {
+  return MetricsRegistry::instance().histogram(
+      "id_generator_backend_request_duration_seconds",
+      "Round-trip latency of database and HTTP requests made by "
+      "backend-driven generators.",
+      string("generator=\"") + generator + "\",operation=\"" + operation +
+          "\"");
+}
+
+LatencyHistogram& server_response_latency(const char* backend) {
+  return MetricsRegistry::instance().histogram(
+      "sidecar_response_duration_seconds",
+      "Time from accepting a one-shot connection, or reading a request on a "
+      "persistent one, until its response was handed to the kernel.",
+      string("backend=\"") + backend + "\"");
+}
+
+Counter& server_accepted_counter(const char* backend) {
+  return MetricsRegistry::instance().counter(
+      "sidecar_connections_accepted_total", "Client connections accepted.",
+      string("backend=\"") + backend + "\"");
+}
@@ -0,0 +1,152 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Process-wide metrics exposed in the Prometheus text format.
+ *
+ * Metrics are registered once (usually in a constructor) and the returned
+ * reference is kept, so the hot path never looks anything up. Recording is
+ * lock-free: counters and gauges are relaxed atomics and histograms spread
+ * their buckets over cache-line-aligned stripes picked per thread, so
+ * concurrent workers do not bounce the same line.
+ *
+ * Latency timing costs two clock reads, so histograms only record while
+ * metrics are enabled (METRICS_PORT is set); counters always count.
+ */
+
+// Set once at startup, before any worker thread runs
+extern bool metrics_enabled;
+
+inline uint64_t metrics_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class Counter {
+ private:
+  std::atomic<uint64_t> value{0};
+
+ public:
+  void inc(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// A value that can go up and down, e.g. the current clock skew
+class Gauge {
+ private:
+  std::atomic<int64_t> value{0};
+
+ public:
+  void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+  int64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+/**
+ * Log-linear latency histogram in nanoseconds (HDR-style with one
+ * sub-bucket bit): every power of two from 64 ns to ~34 s is split into two
+ * buckets, so a recorded value is off by at most 25%.
+ */
+class LatencyHistogram {
+ public:
+  static const int MIN_EXPONENT = 6;   // 64 ns
+  static const int MAX_EXPONENT = 35;  // ~34 s
+  static const int BUCKETS = (MAX_EXPONENT - MIN_EXPONENT) * 2 + 2;
+
+  void record_ns(uint64_t ns);
+
+  // Upper bound (inclusive, in ns) of bucket i; the last bucket is +Inf
+  static uint64_t bucket_bound_ns(int i);
+
+  // Sums the stripes; counts[i] is the number of values in bucket i
+  void snapshot(uint64_t* counts, uint64_t* sum_ns) const;
+
+ private:
+  static const int STRIPES = 16;
+
+  struct alignas(64) Stripe {
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> sum_ns;
+    Stripe() : sum_ns(0) {
+      for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  Stripe stripes[STRIPES];
+};
+
+/**
+ * Records the time between construction and destruction into a histogram,
+ * when metrics are enabled.
+ */
+class ScopedLatency {
+ private:
+  LatencyHistogram& histogram;
+  uint64_t start_ns;
+
+ public:
+  explicit ScopedLatency(LatencyHistogram& histogram)
+      : histogram(histogram), start_ns(metrics_enabled ? metrics_now_ns() : 0) {}
+  ~ScopedLatency() {
+    if (start_ns) histogram.record_ns(metrics_now_ns() - start_ns);
+  }
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
+
+class MetricsRegistry {
+ private:
+  struct Series {
+    std::string name;
+    std::string help;
+    std::string labels;  // Rendered label pairs, e.g. generator="sonyflake"
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<LatencyHistogram> histogram;
+  };
+
+  mutable std::mutex mtx;  // Guards registration and rendering only
+  std::vector<Series> series;
+
+  Series* find(const std::string& name, const std::string& labels);
+
+ public:
+  static MetricsRegistry& instance();
+
+  // Returns the existing series for name+labels, or registers a new one
+  Counter& counter(const std::string& name, const std::string& help,
+                   const std::string& labels = "");
+  Gauge& gauge(const std::string& name, const std::string& help,
+               const std::string& labels = "");
+  LatencyHistogram& histogram(const std::string& name,
+                              const std::string& help,
+                              const std::string& labels = "");
+
+  // Prometheus text exposition format (version 0.0.4)
+  std::string render() const;
+};
+
+// Per-generator series shared by several generators, labelled
+// generator="<generator>"
+Counter& cas_retries_counter(const char* generator);
+Counter& sequence_exhausted_counter(const char* generator);
+Counter& clock_backwards_counter(const char* generator);
+LatencyHistogram& sequence_wait_latency(const char* generator);
+Gauge& clock_skew_gauge(const char* generator);
+Gauge& segment_step_gauge(const char* generator);
+LatencyHistogram& backend_latency(const char* generator,
+                                  const char* operation);
+
+// Sidecar server series, labelled backend="epoll" or backend="io_uring"
+LatencyHistogram& server_response_latency(const char* backend);
+Counter& server_accepted_counter(const char* backend);
+
+#endif  // METRICS_H
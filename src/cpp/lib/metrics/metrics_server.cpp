@@ -0,0 +1,94 @@
+#include "metrics_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "../server/http_parser.h"
+#include "../server/listener.h"
+#include "metrics.h"
+
+using namespace std;
+
+// A scraper that stalls longer than this is dropped
+static const int SCRAPE_TIMEOUT_SEC = 5;
+
+static void send_all(int fd, const string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t n = send(fd, data.data() + offset, data.size() - offset,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    offset += n;
+  }
+}
+
+static void serve_scrape(int fd) {
+  struct timeval timeout = {SCRAPE_TIMEOUT_SEC, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  char buffer[HTTP_MAX_HEAD_SIZE];
+  size_t len = 0;
+  HttpRequest request;
+  HttpParse result = HttpParse::INCOMPLETE;
+  while (result == HttpParse::INCOMPLETE && len < sizeof(buffer)) {
+    ssize_t n = recv(fd, buffer + len, sizeof(buffer) - len, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    len += n;
+    result = http_parse_request(buffer, len, &request);
+  }
+
+  string status = "200 OK";
+  string content_type = "text/plain; version=0.0.4";
+  string body;
+  if (result != HttpParse::COMPLETE) {
+    status = "400 Bad Request";
+    body = "Bad Request\n";
+  } else if (request.path_len != 8 || memcmp(request.path, "/metrics", 8)) {
+    status = "404 Not Found";
+    body = "Not Found\n";
+  } else {
+    body = MetricsRegistry::instance().render();
+  }
+
+  send_all(fd, "HTTP/1.1 " + status + "\r\nContent-Type: " + content_type +
+                   "\r\nContent-Length: " + to_string(body.size()) +
+                   "\r\nConnection: close\r\n\r\n" + body);
+}
+
+bool start_metrics_server(int port) {
+  int listen_fd = create_tcp_listener(port, 16);
+  if (listen_fd < 0) {
+    return false;
+  }
+  // This thread only ever waits for scrapes, so block in accept()
+  fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) & ~O_NONBLOCK);
+
+  thread([listen_fd]() {
+    while (true) {
+      int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno != EINTR && errno != ECONNABORTED) {
+          perror("Metrics accept failed");
+          this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        continue;
+      }
+      serve_scrape(fd);
+      close(fd);
+    }
+  }).detach();
+
+  return true;
+}
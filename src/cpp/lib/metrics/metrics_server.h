@@ -0,0 +1,13 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+/**
+ * Serves MetricsRegistry::instance() in the Prometheus text format on
+ * GET /metrics at the given TCP port, from a background thread. Scrapes are
+ * rare, so connections are handled one at a time with blocking I/O.
+ *
+ * @return false if the port could not be bound.
+ */
+bool start_metrics_server(int port);
+
+#endif  // METRICS_SERVER_H
@@ -0,0 +1,383 @@
+#include "mysql_pool.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Connect, read and write timeout of every connection, in seconds
+static const unsigned int IO_TIMEOUT_SECONDS = 5;
+
+MysqlPoolConfig MysqlPoolConfig::from_env(const char* default_host,
+                                          int default_port) {
+  MysqlPoolConfig config;
+  int port = getenv("DB_PORT") ? atoi(getenv("DB_PORT")) : default_port;
+
+  if (getenv("DB_HOSTS")) {
+    stringstream hosts(getenv("DB_HOSTS"));
+    string entry;
+    while (getline(hosts, entry, ',')) {
+      if (entry.empty()) {
+        continue;
+      }
+      size_t colon = entry.find(':');
+      if (colon == string::npos) {
+        config.endpoints.push_back({entry, port});
+      } else {
+        config.endpoints.push_back(
+            {entry.substr(0, colon), atoi(entry.c_str() + colon + 1)});
+      }
+    }
+  }
+  if (config.endpoints.empty()) {
+    config.endpoints.push_back(
+        {getenv("DB_HOST") ? getenv("DB_HOST") : default_host, port});
+  }
+
+  config.user = getenv("DB_USER") ? getenv("DB_USER") : "root";
+  config.password = getenv("DB_PASS") ? getenv("DB_PASS") : "root";
+  config.database = getenv("DB_NAME") ? getenv("DB_NAME") : "uuid_db";
+
+  if (getenv("DB_POOL_SIZE")) {
+    config.connections_per_endpoint = atoi(getenv("DB_POOL_SIZE"));
+  }
+  if (config.connections_per_endpoint < 1) {
+    config.connections_per_endpoint = 1;
+  }
+  if (getenv("DB_POOL_HEALTH_MS")) {
+    config.health_check_ms = atoi(getenv("DB_POOL_HEALTH_MS"));
+  }
+  if (getenv("DB_POOL_WAIT_MS")) {
+    config.acquire_timeout_ms = atoi(getenv("DB_POOL_WAIT_MS"));
+  }
+  return config;
+}
+
+MysqlPool::MysqlPool(MysqlPoolConfig config) : config(move(config)) {
+  size_t endpoints = this->config.endpoints.size();
+  size_t count = endpoints * this->config.connections_per_endpoint;
+  for (size_t i = 0; i < count; ++i) {
+    // Interleaved, so round-robin leasing alternates between endpoints
+    auto slot = make_unique<Slot>();
+    slot->endpoint = i % endpoints;
+    slot->healthy = connect(*slot);
+    slots.push_back(move(slot));
+  }
+
+  health_thread = thread(&MysqlPool::health_loop, this);
+}
+
+MysqlPool::~MysqlPool() {
+  {
+    lock_guard<mutex> lock(mtx);
+    is_running = false;
+  }
+  cv_repair.notify_one();
+  if (health_thread.joinable()) {
+    health_thread.join();
+  }
+  for (auto& slot : slots) {
+    close(*slot);
+  }
+}
+
+void MysqlPool::close(Slot& slot) {
+  for (auto& statement : slot.statements) {
+    mysql_stmt_close(statement.second);
+  }
+  slot.statements.clear();
+  if (slot.conn) {
+    mysql_close(slot.conn);
+    slot.conn = nullptr;
+  }
+}
+
+bool MysqlPool::connect(Slot& slot) {
+  close(slot);
+  slot.increment = 0;  // May differ on the new server
+  slot.conn = mysql_init(NULL);
+  if (slot.conn == NULL) {
+    cerr << "mysql_init() failed" << endl;
+    return false;
+  }
+
+  if (config.disable_ssl) {
+    unsigned int ssl_mode = SSL_MODE_DISABLED;
+    mysql_options(slot.conn, MYSQL_OPT_SSL_MODE, &ssl_mode);
+  }
+  // Bounded, so a dead master cannot hang a caller or the health thread
+  mysql_options(slot.conn, MYSQL_OPT_CONNECT_TIMEOUT, &IO_TIMEOUT_SECONDS);
+  mysql_options(slot.conn, MYSQL_OPT_READ_TIMEOUT, &IO_TIMEOUT_SECONDS);
+  mysql_options(slot.conn, MYSQL_OPT_WRITE_TIMEOUT, &IO_TIMEOUT_SECONDS);
+
+  const MysqlEndpoint& endpoint = config.endpoints[slot.endpoint];
+  if (mysql_real_connect(slot.conn, endpoint.host.c_str(),
+                         config.user.c_str(), config.password.c_str(),
+                         config.database.c_str(), endpoint.port, NULL,
+                         0) == NULL) {
+    cerr << "mysql_real_connect() to " << endpoint.host << ":"
+         << endpoint.port << " failed: " << mysql_error(slot.conn) << endl;
+    return false;
+  }
+
+  for (const string& query : config.init_queries) {
+    if (mysql_query(slot.conn, query.c_str())) {
+      cerr << "Connection setup query failed: " << mysql_error(slot.conn)
+           << endl;
+    }
+  }
+  return true;
+}
+
+// Called with the slot leased
+uint64_t MysqlPool::read_increment(Slot& slot) {
+  if (slot.increment != 0) {
+    return slot.increment;
+  }
+  if (mysql_query(slot.conn, "SELECT @@auto_increment_increment")) {
+    cerr << "Failed to read auto_increment_increment: "
+         << mysql_error(slot.conn) << endl;
+    return 0;
+  }
+  MYSQL_RES* result = mysql_store_result(slot.conn);
+  if (result == NULL) {
+    return 0;
+  }
+  MYSQL_ROW row = mysql_fetch_row(result);
+  slot.increment = row && row[0] ? strtoull(row[0], nullptr, 10) : 0;
+  mysql_free_result(result);
+  return slot.increment;
+}
+
+MysqlPool::Slot* MysqlPool::take_idle() {
+  for (size_t i = 0; i < slots.size(); ++i) {
+    size_t index = (next_slot + i) % slots.size();
+    Slot& slot = *slots[index];
+    if (slot.healthy && !slot.leased) {
+      slot.leased = true;
+      next_slot = index + 1;
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+void MysqlPool::release(Slot* slot, bool broken) {
+  {
+    lock_guard<mutex> lock(mtx);
+    slot->leased = false;
+    if (broken) {
+      slot->healthy = false;
+    }
+  }
+  if (broken) {
+    cv_repair.notify_one();
+  } else {
+    cv_idle.notify_one();
+  }
+}
+
+void MysqlPool::health_loop() {
+  auto next_ping = chrono::steady_clock::now();
+
+  while (true) {
+    {
+      unique_lock<mutex> lock(mtx);
+      cv_repair.wait_until(lock, next_ping);
+      if (!is_running) {
+        return;
+      }
+    }
+
+    bool ping_due = chrono::steady_clock::now() >= next_ping;
+    if (ping_due) {
+      next_ping = chrono::steady_clock::now() +
+                  chrono::milliseconds(config.health_check_ms);
+    }
+
+    for (auto& slot : slots) {
+      bool was_healthy;
+      {
+        lock_guard<mutex> lock(mtx);
+        if (slot->leased || (slot->healthy && !ping_due)) {
+          continue;
+        }
+        slot->leased = true;  // Keep callers off it while it is checked
+        was_healthy = slot->healthy;
+      }
+
+      bool healthy = was_healthy && mysql_ping(slot->conn) == 0;
+      if (!healthy) {
+        healthy = connect(*slot);
+      }
+
+      {
+        lock_guard<mutex> lock(mtx);
+        slot->healthy = healthy;
+        slot->leased = false;
+      }
+      cv_idle.notify_all();
+    }
+  }
+}
+
+MysqlPool::Lease MysqlPool::acquire() {
+  unique_lock<mutex> lock(mtx);
+  Slot* slot = nullptr;
+  cv_idle.wait_for(lock, chrono::milliseconds(config.acquire_timeout_ms),
+                   [&] { return (slot = take_idle()) != nullptr; });
+  return slot ? Lease(this, slot) : Lease();
+}
+
+size_t MysqlPool::execute_concurrently(const string& sql, size_t count,
+                                       uint64_t* insert_ids,
+                                       uint64_t* increments) {
+  vector<Slot*> taken;
+  {
+    unique_lock<mutex> lock(mtx);
+    Slot* first = nullptr;
+    cv_idle.wait_for(lock, chrono::milliseconds(config.acquire_timeout_ms),
+                     [&] { return (first = take_idle()) != nullptr; });
+    if (first == nullptr) {
+      return 0;
+    }
+    taken.push_back(first);
+    while (taken.size() < count) {
+      Slot* slot = take_idle();
+      if (slot == nullptr) {
+        break;
+      }
+      taken.push_back(slot);
+    }
+  }
+
+  // Send every query before waiting for any reply
+  vector<net_async_status> status(taken.size());
+  for (size_t i = 0; i < taken.size(); ++i) {
+    status[i] = mysql_real_query_nonblocking(taken[i]->conn, sql.data(),
+                                             sql.size());
+  }
+
+  // A query may still be waiting to be written (a large multi-row REPLACE
+  // fills the send buffer), so wait for the socket to become writable too
+  // until the library has moved on to reading the reply
+  vector<short> events(taken.size(), POLLIN | POLLOUT);
+  vector<size_t> polled;
+  vector<struct pollfd> fds;
+  auto deadline = chrono::steady_clock::now() +
+                  chrono::seconds(IO_TIMEOUT_SECONDS);
+  while (true) {
+    fds.clear();
+    polled.clear();
+    for (size_t i = 0; i < taken.size(); ++i) {
+      if (status[i] == NET_ASYNC_NOT_READY) {
+        fds.push_back({mysql_get_socket(taken[i]->conn), events[i], 0});
+        polled.push_back(i);
+      }
+    }
+    auto now = chrono::steady_clock::now();
+    if (fds.empty() || now >= deadline) {
+      break;
+    }
+
+    // NOT_READY means the library ran into EAGAIN, so nothing is buffered
+    // in it: the next step can only follow a socket event. A connection
+    // judged to be reading may really have been mid-send (the peer drained
+    // the buffer just before the check), so those are re-checked now and
+    // then.
+    int timeout = static_cast<int>(
+        chrono::duration_cast<chrono::milliseconds>(deadline - now).count() +
+        1);
+    for (size_t i : polled) {
+      if (!(events[i] & POLLOUT)) {
+        timeout = min(timeout, 10);
+      }
+    }
+    bool timed_out = poll(fds.data(), fds.size(), timeout) <= 0;
+    for (size_t k = 0; k < fds.size(); ++k) {
+      size_t i = polled[k];
+      if (timed_out) {
+        events[i] = POLLIN | POLLOUT;
+      } else if (fds[k].revents == 0) {
+        continue;
+      }
+      status[i] = mysql_real_query_nonblocking(taken[i]->conn, sql.data(),
+                                               sql.size());
+      if (status[i] == NET_ASYNC_NOT_READY && (events[i] & POLLOUT)) {
+        // Still writable, yet not done: the query is sent and the library
+        // waits for the reply, which POLLOUT would only spin on
+        struct pollfd probe = {fds[k].fd, POLLOUT, 0};
+        if (poll(&probe, 1, 0) == 1 && (probe.revents & POLLOUT)) {
+          events[i] = POLLIN;
+        }
+      }
+    }
+  }
+
+  size_t succeeded = 0;
+  for (size_t i = 0; i < taken.size(); ++i) {
+    bool ok = status[i] == NET_ASYNC_COMPLETE;
+    if (ok) {
+      insert_ids[succeeded] = mysql_insert_id(taken[i]->conn);
+      if (increments) {
+        // From the connection that ran the query, so it matches its master
+        increments[succeeded] = read_increment(*taken[i]);
+      }
+      ++succeeded;
+    } else {
+      cerr << "Query failed: " << mysql_error(taken[i]->conn) << endl;
+    }
+    // A query still in flight leaves the connection unusable, too
+    release(taken[i], !ok);
+  }
+  return succeeded;
+}
+
+MysqlPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), slot(other.slot), broken(other.broken) {
+  other.slot = nullptr;
+}
+
+MysqlPool::Lease& MysqlPool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    if (slot) {
+      pool->release(slot, broken);
+    }
+    pool = other.pool;
+    slot = other.slot;
+    broken = other.broken;
+    other.slot = nullptr;
+  }
+  return *this;
+}
+
+MysqlPool::Lease::~Lease() {
+  if (slot) {
+    pool->release(slot, broken);
+  }
+}
+
+MYSQL_STMT* MysqlPool::Lease::statement(const string& sql) {
+  auto found = slot->statements.find(sql);
+  if (found != slot->statements.end()) {
+    return found->second;
+  }
+
+  MYSQL_STMT* stmt = mysql_stmt_init(slot->conn);
+  if (stmt == NULL || mysql_stmt_prepare(stmt, sql.data(), sql.size())) {
+    cerr << "Failed to prepare statement: " << mysql_error(slot->conn)
+         << endl;
+    if (stmt) {
+      mysql_stmt_close(stmt);
+    }
+    broken = true;
+    return nullptr;
+  }
+  slot->statements[sql] = stmt;
+  return stmt;
+}
@@ -0,0 +1,143 @@
+#ifndef MYSQL_POOL_H
+#define MYSQL_POOL_H
+
+#include <mysql/mysql.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MysqlEndpoint {
+  std::string host;
+  int port;
+};
+
+/**
+ * Settings of a MysqlPool, read from the same environment variables the
+ * database-backed generators always used, plus a few pool-specific ones.
+ */
+struct MysqlPoolConfig {
+  // DB_HOSTS ("host:port,host:port"), or else DB_HOST and DB_PORT
+  std::vector<MysqlEndpoint> endpoints;
+  std::string user;      // DB_USER
+  std::string password;  // DB_PASS
+  std::string database;  // DB_NAME
+
+  int connections_per_endpoint = 2;  // DB_POOL_SIZE
+  int health_check_ms = 1000;        // DB_POOL_HEALTH_MS
+  int acquire_timeout_ms = 2000;     // DB_POOL_WAIT_MS
+  bool disable_ssl = false;
+
+  // Run after every (re)connect, e.g. CREATE TABLE IF NOT EXISTS
+  std::vector<std::string> init_queries;
+
+  static MysqlPoolConfig from_env(const char* default_host, int default_port);
+};
+
+/**
+ * A fixed set of MySQL connections shared by one generator's callers.
+ *
+ * Connections are spread round-robin over the configured endpoints (e.g.
+ * both masters), so load and failures are split between them. Callers
+ * never connect: a connection whose query fails is marked broken and
+ * handed to a background thread, which reconnects it and also pings idle
+ * connections every `health_check_ms`. Until then callers use the other
+ * connections.
+ *
+ * Two ways to run queries:
+ * - acquire() leases one connection for a blocking exchange, with its own
+ *   cache of prepared statements (re-prepared after a reconnect).
+ * - execute_concurrently() sends one text query on several idle
+ *   connections at once with the client library's non-blocking API and
+ *   polls their sockets, so N round trips cost about one.
+ */
+class MysqlPool {
+ private:
+  struct Slot {
+    MYSQL* conn = nullptr;
+    size_t endpoint = 0;
+    bool healthy = false;
+    bool leased = false;
+    uint64_t increment = 0;  // auto_increment_increment; 0: not read yet
+    std::map<std::string, MYSQL_STMT*> statements;
+  };
+
+  MysqlPoolConfig config;
+  std::vector<std::unique_ptr<Slot>> slots;
+  size_t next_slot = 0;  // Round-robin start of the next search
+
+  std::mutex mtx;  // Guards the healthy/leased flags and next_slot
+  std::condition_variable cv_idle;    // A connection was released
+  std::condition_variable cv_repair;  // A connection broke
+
+  std::thread health_thread;
+  std::atomic<bool> is_running{true};
+
+  bool connect(Slot& slot);
+  void close(Slot& slot);
+  uint64_t read_increment(Slot& slot);
+  Slot* take_idle();  // Called with mtx held
+  void release(Slot* slot, bool broken);
+  void health_loop();
+
+ public:
+  /**
+   * A leased connection; returned to the pool when destroyed. Evaluates to
+   * false if no healthy connection became idle in time.
+   */
+  class Lease {
+   private:
+    MysqlPool* pool = nullptr;
+    Slot* slot = nullptr;
+    bool broken = false;
+
+   public:
+    Lease() = default;
+    Lease(MysqlPool* pool, Slot* slot) : pool(pool), slot(slot) {}
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    ~Lease();
+
+    explicit operator bool() const { return slot != nullptr; }
+    MYSQL* get() const { return slot->conn; }
+
+    // Prepared once per connection; nullptr (and the lease marked broken)
+    // if preparing fails
+    MYSQL_STMT* statement(const std::string& sql);
+
+    // The connection failed; it is reconnected in the background
+    void mark_broken() { broken = true; }
+  };
+
+  explicit MysqlPool(MysqlPoolConfig config);
+  ~MysqlPool();
+
+  MysqlPool(const MysqlPool&) = delete;
+  MysqlPool& operator=(const MysqlPool&) = delete;
+
+  // Waits up to acquire_timeout_ms for a healthy idle connection
+  Lease acquire();
+
+  /**
+   * Runs `sql` (a statement without a result set) on up to `count` idle
+   * connections at once; waits for at least one like acquire().
+   *
+   * @param insert_ids Receives mysql_insert_id() of each successful run
+   * @param increments If not null, receives the auto_increment_increment
+   *   of the connection behind each successful run (read on first use
+   *   after every connect), or 0 if it could not be read
+   * @return Number of successful runs
+   */
+  size_t execute_concurrently(const std::string& sql, size_t count,
+                              uint64_t* insert_ids,
+                              uint64_t* increments = nullptr);
+};
+
+#endif  // MYSQL_POOL_H
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "id_generator.h"
 
@@ -51,4 +52,31 @@ inline uint64_t get_node_id_from_ip(uint64_t mask = MAX_NODE_ID) {
   return node_id;
 }
 
+/**
+ * Derives `count` consecutive node IDs from the container's IPv4 address,
+ * for generators that stripe over several node IDs.
+ *
+ * The low IP bits fill the upper part of the node field and the stripe
+ * index the lowest ceil(log2(count)) bits, so with count == 1 this is
+ * get_node_id_from_ip(mask). Pods whose addresses differ only in the bits
+ * given up to the stripe index get the same IDs.
+ *
+ * @param mask The node field's bitmask (e.g., MAX_NODE_ID)
+ * @param count Number of node IDs; at most mask + 1
+ */
+inline std::vector<uint64_t> get_node_ids_from_ip(uint64_t mask,
+                                                  uint64_t count) {
+  int stripe_bits = 0;
+  while ((static_cast<uint64_t>(1) << stripe_bits) < count) {
+    ++stripe_bits;
+  }
+
+  uint64_t base = get_node_id_from_ip(mask >> stripe_bits) << stripe_bits;
+  std::vector<uint64_t> ids;
+  for (uint64_t i = 0; i < count; ++i) {
+    ids.push_back(base | i);
+  }
+  return ids;
+}
+
 #endif  // NETWORK_UTIL_H
@@ -0,0 +1,39 @@
+#ifndef UNIX_ADDRESS_H
+#define UNIX_ADDRESS_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/**
+ * Fills a sockaddr_un for the sidecar's AF_UNIX endpoint.
+ *
+ * A name starting with '@' lives in the Linux abstract namespace (no file
+ * on disk, gone when the socket closes); anything else is a filesystem
+ * path, e.g. inside an emptyDir volume shared by the pod's containers.
+ *
+ * @return The address length to pass to bind()/connect(), or 0 if the name
+ * does not fit in sun_path.
+ */
+inline socklen_t make_unix_address(const std::string& name,
+                                   struct sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+
+  if (name.empty() || name.size() >= sizeof(addr->sun_path)) {
+    return 0;
+  }
+
+  memcpy(addr->sun_path, name.data(), name.size());
+  if (name[0] == '@') {
+    // Abstract names start with a NUL byte and are not NUL-terminated
+    addr->sun_path[0] = '\0';
+    return offsetof(struct sockaddr_un, sun_path) + name.size();
+  }
+  return sizeof(*addr);
+}
+
+#endif  // UNIX_ADDRESS_H
@@ -0,0 +1,119 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Binary batch protocol shared by the sidecar and its clients.
+ *
+ * Requests and responses start with the same 12-byte little-endian header:
+ *
+ *   offset 0  uint8   magic    (WIRE_MAGIC)
+ *   offset 1  uint8   version  (WIRE_VERSION)
+ *   offset 2  uint8   format   (IdFormat)
+ *   offset 3  uint8   status   (WireStatus; 0 in requests)
+ *   offset 4  uint32  count    (IDs requested / IDs returned)
+ *   offset 8  uint32  length   (payload bytes following the header)
+ *
+ * A request asks for `count` IDs in `format`. Its optional payload names
+ * the ID sequence to draw from (a biz_tag of up to WIRE_MAX_TAG_SIZE
+ * characters from [A-Za-z0-9_.:-]); without one the default sequence is
+ * used. Only generators that keep several sequences accept a tag; others
+ * answer STATUS_BAD_REQUEST. The response payload holds `count` packed IDs:
+ *
+ *   FORMAT_U64   8 bytes each, little-endian
+ *   FORMAT_U128  16 bytes each, RFC 4122 byte order (ready for BINARY(16))
+ *   FORMAT_TEXT  uint16 little-endian length followed by the characters
+ *
+ * A non-zero status means no IDs were generated; count and length are 0.
+ */
+
+const uint8_t WIRE_MAGIC = 0xA5;
+const uint8_t WIRE_VERSION = 1;
+const size_t WIRE_HEADER_SIZE = 12;
+
+// Largest batch a single request may ask for
+const uint32_t WIRE_MAX_COUNT = 16384;
+
+// Largest request payload the sidecar will buffer
+const uint32_t WIRE_MAX_REQUEST_PAYLOAD = 4096;
+
+// Longest sequence tag a request may carry
+const uint32_t WIRE_MAX_TAG_SIZE = 64;
+
+enum IdFormat : uint8_t {
+  FORMAT_NATIVE = 0,  // Request only: whatever the generator produces
+  FORMAT_U64 = 1,
+  FORMAT_U128 = 2,
+  FORMAT_TEXT = 3,
+};
+
+enum WireStatus : uint8_t {
+  STATUS_OK = 0,
+  STATUS_BAD_VERSION = 1,
+  STATUS_BAD_REQUEST = 2,
+  STATUS_UNSUPPORTED_FORMAT = 3,
+  STATUS_COUNT_TOO_LARGE = 4,
+  STATUS_GENERATION_FAILED = 5,
+};
+
+struct WireHeader {
+  uint8_t magic = WIRE_MAGIC;
+  uint8_t version = WIRE_VERSION;
+  uint8_t format = FORMAT_NATIVE;
+  uint8_t status = STATUS_OK;
+  uint32_t count = 0;
+  uint32_t length = 0;
+};
+
+inline void wire_put_le16(uint8_t* p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void wire_put_le32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+inline void wire_put_le64(uint8_t* p, uint64_t v) {
+  for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+inline uint16_t wire_get_le16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t wire_get_le32(const uint8_t* p) {
+  uint32_t v = 0;
+  for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+inline uint64_t wire_get_le64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+inline void wire_encode_header(const WireHeader& h, uint8_t* out) {
+  out[0] = h.magic;
+  out[1] = h.version;
+  out[2] = h.format;
+  out[3] = h.status;
+  wire_put_le32(out + 4, h.count);
+  wire_put_le32(out + 8, h.length);
+}
+
+inline WireHeader wire_decode_header(const uint8_t* in) {
+  WireHeader h;
+  h.magic = in[0];
+  h.version = in[1];
+  h.format = in[2];
+  h.status = in[3];
+  h.count = wire_get_le32(in + 4);
+  h.length = wire_get_le32(in + 8);
+  return h;
+}
+
+#endif  // WIRE_PROTOCOL_H
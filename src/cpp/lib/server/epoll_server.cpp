@@ -0,0 +1,321 @@
+#include "epoll_server.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include "listener.h"
+
+using namespace std;
+
+// Maximum number of events handled per epoll_wait() call
+static const int MAX_EVENTS = 256;
+
+// How often idle connections are swept when no events arrive
+static const int SWEEP_INTERVAL_MS = 1000;
+
+// Stop reading from a peer once this many response bytes are queued for it
+static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+// Largest single message written to a SOCK_SEQPACKET peer. Unix datagrams
+// must fit in the socket send buffer, which is capped by net.core.wmem_max.
+static const size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
+static uint64_t steady_millis() {
+  return chrono::duration_cast<chrono::milliseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+EpollServer::EpollServer(IdGenerator& generator, const ServerConfig& config,
+                         int shared_unix_fd)
+    : generator(generator),
+      config(config),
+      shared_unix_fd(shared_unix_fd),
+      response_latency(server_response_latency("epoll")),
+      accepted(server_accepted_counter("epoll")) {}
+
+EpollServer::~EpollServer() {
+  for (auto& entry : connections) {
+    close(entry.first);
+  }
+  if (epoll_fd >= 0) {
+    close(epoll_fd);
+  }
+  for (const Listener& listener : listeners) {
+    if (listener.owned) {
+      close(listener.fd);
+    }
+  }
+}
+
+bool EpollServer::open_listeners() {
+  if (config.port > 0) {
+    int fd = create_tcp_listener(config.port, config.backlog);
+    if (fd < 0) return false;
+    listeners.push_back({fd, true, false, true});
+  }
+
+  if (shared_unix_fd >= 0) {
+    listeners.push_back({shared_unix_fd, false, config.unix_seqpacket, false});
+  }
+
+  if (listeners.empty()) {
+    cerr << "No listener configured (SERVER_PORT=0 and no SIDECAR_UNIX_SOCKET)"
+         << endl;
+    return false;
+  }
+  return true;
+}
+
+void EpollServer::run() {
+  if (!open_listeners()) {
+    return;
+  }
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1 failed");
+    return;
+  }
+
+  for (const Listener& listener : listeners) {
+    struct epoll_event ev = {};
+    // Wake only one worker per connection on a listener shared between
+    // several epoll sets
+    ev.events = listener.owned ? EPOLLIN : EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.fd = listener.fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener.fd, &ev) < 0) {
+      perror("epoll_ctl failed");
+      return;
+    }
+  }
+
+  struct epoll_event events[MAX_EVENTS];
+  uint64_t last_sweep_ms = steady_millis();
+
+  while (true) {
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS, SWEEP_INTERVAL_MS);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait failed");
+      return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      const Listener* listener = nullptr;
+      for (const Listener& l : listeners) {
+        if (l.fd == fd) listener = &l;
+      }
+
+      if (listener) {
+        accept_connections(*listener);
+      } else {
+        handle_event(fd, events[i].events);
+      }
+    }
+
+    uint64_t now_ms = steady_millis();
+    if (now_ms - last_sweep_ms >= SWEEP_INTERVAL_MS) {
+      close_idle_connections(now_ms);
+      last_sweep_ms = now_ms;
+    }
+  }
+}
+
+void EpollServer::accept_connections(const Listener& listener) {
+  // The listener is level-triggered, so drain the whole accept queue here
+  while (true) {
+    int fd = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      // EMFILE/ENFILE and friends: leave the rest queued for the next wakeup
+      perror("Accept failed");
+      return;
+    }
+
+    accepted.inc();
+
+    if (config.mode == ServerMode::ONESHOT) {
+      serve_oneshot(fd);
+      continue;
+    }
+
+    if (connections.size() >= static_cast<size_t>(config.max_connections)) {
+      cerr << "Connection limit (" << config.max_connections
+           << ") reached, rejecting client" << endl;
+      close(fd);
+      continue;
+    }
+
+    if (listener.is_tcp) {
+      // Responses are tiny; don't let Nagle hold them back
+      int opt = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    }
+
+    auto result = connections.emplace(
+        piecewise_construct, forward_as_tuple(fd),
+        forward_as_tuple(fd, listener.message_mode, generator));
+    Connection& conn = result.first->second;
+    conn.last_active_ms = steady_millis();
+    conn.interest = EPOLLIN | EPOLLRDHUP;
+
+    struct epoll_event ev = {};
+    ev.events = conn.interest;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("epoll_ctl failed");
+      connections.erase(fd);
+      close(fd);
+    }
+  }
+}
+
+void EpollServer::serve_oneshot(int fd) {
+  // A freshly accepted socket has an empty send buffer, so a single ID
+  // always fits without blocking.
+  ScopedLatency timer(response_latency);
+  string id_str = generator.next_id_string();
+  send(fd, id_str.c_str(), id_str.length(), MSG_NOSIGNAL);
+
+  // Close the connection immediately after sending (stateless IPC)
+  close(fd);
+}
+
+void EpollServer::handle_event(int fd, uint32_t events) {
+  auto it = connections.find(fd);
+  if (it == connections.end()) {
+    return;
+  }
+  Connection& conn = it->second;
+  conn.last_active_ms = steady_millis();
+
+  if (events & EPOLLERR) {
+    close_connection(fd);
+    return;
+  }
+
+  if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !conn.draining) {
+    // Stop reading after EOF or a protocol error, but still deliver the
+    // answers already queued for this peer
+    conn.draining = !read_requests(conn);
+  }
+
+  if (!flush_output(conn) || (conn.draining && conn.out.empty())) {
+    close_connection(fd);
+    return;
+  }
+
+  update_interest(conn);
+}
+
+bool EpollServer::read_requests(Connection& conn) {
+  char buffer[16384];
+
+  while (conn.out.size() - conn.out_offset < MAX_PENDING_OUTPUT) {
+    ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      uint64_t read_ns = metrics_enabled ? metrics_now_ns() : 0;
+      bool keep_open = conn.session.on_data(buffer, n, conn.out);
+      if (conn.pending_since_ns == 0 && !conn.out.empty()) {
+        conn.pending_since_ns = read_ns;
+      }
+      if (!keep_open) {
+        return false;
+      }
+      continue;
+    }
+    if (n == 0) {
+      return false;  // Peer closed its side
+    }
+    if (errno == EINTR) continue;
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+
+  return true;
+}
+
+bool EpollServer::flush_output(Connection& conn) {
+  while (conn.out_offset < conn.out.size()) {
+    size_t len = conn.out.size() - conn.out_offset;
+    if (conn.message_mode && len > MAX_MESSAGE_SIZE) {
+      len = MAX_MESSAGE_SIZE;
+    }
+    ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset, len,
+                     MSG_NOSIGNAL);
+    if (n > 0) {
+      conn.out_offset += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;  // Socket buffer full, wait for EPOLLOUT
+    }
+    return false;
+  }
+
+  conn.out.clear();
+  conn.out_offset = 0;
+  if (conn.pending_since_ns) {
+    response_latency.record_ns(metrics_now_ns() - conn.pending_since_ns);
+    conn.pending_since_ns = 0;
+  }
+  return true;
+}
+
+void EpollServer::update_interest(Connection& conn) {
+  size_t pending = conn.out.size() - conn.out_offset;
+  uint32_t interest = 0;
+  if (!conn.draining && pending < MAX_PENDING_OUTPUT) {
+    interest |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (pending > 0) {
+    interest |= EPOLLOUT;
+  }
+
+  if (interest == conn.interest) {
+    return;
+  }
+
+  struct epoll_event ev = {};
+  ev.events = interest;
+  ev.data.fd = conn.fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) < 0) {
+    perror("epoll_ctl failed");
+    close_connection(conn.fd);
+    return;
+  }
+  conn.interest = interest;
+}
+
+void EpollServer::close_connection(int fd) {
+  // Closing the descriptor also removes it from the epoll set
+  connections.erase(fd);
+  close(fd);
+}
+
+void EpollServer::close_idle_connections(uint64_t now_ms) {
+  if (config.idle_timeout_ms <= 0) {
+    return;
+  }
+
+  for (auto it = connections.begin(); it != connections.end();) {
+    if (now_ms - it->second.last_active_ms >=
+        static_cast<uint64_t>(config.idle_timeout_ms)) {
+      close(it->first);
+      it = connections.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef EPOLL_SERVER_H
+#define EPOLL_SERVER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "server_config.h"
+#include "session.h"
+
+/**
+ * Non-blocking, epoll-driven sidecar server.
+ *
+ * In ONESHOT mode every accepted socket receives one ID and is closed,
+ * exactly like the original accept/send/close loop. In PERSISTENT mode
+ * connections stay open and are served by a Session until the peer hangs
+ * up, the idle timeout expires, or a protocol error occurs.
+ *
+ * Several servers can run side by side, one per worker thread: each binds
+ * its own SO_REUSEPORT TCP listener, and an AF_UNIX listener (which cannot
+ * be reuseport-balanced) is shared between their epoll sets.
+ *
+ * Clients may connect over TCP and, when configured, over an AF_UNIX
+ * socket. On SOCK_SEQPACKET sockets responses are still a byte stream, but
+ * each send() is one message of at most 64 KiB, so clients must read with a
+ * buffer at least that large.
+ */
+class EpollServer {
+ private:
+  struct Listener {
+    int fd;
+    bool is_tcp;
+    bool message_mode;  // SOCK_SEQPACKET: every send() is one message
+    bool owned;         // Closed by this server (shared listeners are not)
+  };
+
+  struct Connection {
+    int fd;
+    bool message_mode;
+    Session session;
+    std::string out;
+    size_t out_offset = 0;
+    uint64_t last_active_ms = 0;
+    uint32_t interest = 0;  // Events currently registered with epoll
+    bool draining = false;  // Close once queued output has been sent
+    uint64_t pending_since_ns = 0;  // Oldest unanswered request (metrics)
+
+    Connection(int fd, bool message_mode, IdGenerator& generator)
+        : fd(fd), message_mode(message_mode), session(generator) {}
+  };
+
+  IdGenerator& generator;
+  ServerConfig config;
+  int shared_unix_fd;
+  std::vector<Listener> listeners;
+  int epoll_fd = -1;
+  std::unordered_map<int, Connection> connections;
+  LatencyHistogram& response_latency;
+  Counter& accepted;
+
+  bool open_listeners();
+  void accept_connections(const Listener& listener);
+  void serve_oneshot(int fd);
+  void handle_event(int fd, uint32_t events);
+  bool read_requests(Connection& conn);
+  bool flush_output(Connection& conn);
+  void update_interest(Connection& conn);
+  void close_connection(int fd);
+  void close_idle_connections(uint64_t now_ms);
+
+ public:
+  // shared_unix_fd is the AF_UNIX listener created by the caller (or -1)
+  EpollServer(IdGenerator& generator, const ServerConfig& config,
+              int shared_unix_fd = -1);
+  ~EpollServer();
+
+  // Binds the listeners and runs the event loop. Only returns on a fatal
+  // setup or epoll error.
+  void run();
+};
+
+#endif  // EPOLL_SERVER_H
@@ -0,0 +1,181 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Minimal HTTP/1.x request parser for the sidecar's ID endpoint.
+ *
+ * It never allocates or copies: every field points into the caller's
+ * buffer, which must stay unchanged while the HttpRequest is in use. Only
+ * what the endpoint needs is extracted; other headers are skipped.
+ */
+
+// Requests whose head (request line + headers) exceeds this are rejected
+const size_t HTTP_MAX_HEAD_SIZE = 8192;
+
+struct HttpRequest {
+  const char* method = nullptr;
+  size_t method_len = 0;
+  const char* path = nullptr;  // Target up to '?'
+  size_t path_len = 0;
+  const char* query = nullptr;  // After '?', without it
+  size_t query_len = 0;
+  int minor_version = 1;       // HTTP/1.<minor_version>
+  bool keep_alive = true;
+  bool chunked = false;
+  size_t content_length = 0;
+  size_t head_len = 0;  // Bytes up to and including the blank line
+};
+
+enum class HttpParse { COMPLETE, INCOMPLETE, INVALID };
+
+inline bool http_token_equals(const char* p, size_t len, const char* lower) {
+  size_t n = strlen(lower);
+  if (len != n) return false;
+  for (size_t i = 0; i < n; ++i) {
+    char c = p[i];
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    if (c != lower[i]) return false;
+  }
+  return true;
+}
+
+// True if the comma-separated header value contains `lower` as a token
+inline bool http_value_has_token(const char* p, size_t len, const char* lower) {
+  const char* end = p + len;
+  while (p < end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+    const char* start = p;
+    while (p < end && *p != ',') ++p;
+    const char* stop = p;
+    while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) --stop;
+    if (http_token_equals(start, stop - start, lower)) return true;
+  }
+  return false;
+}
+
+/**
+ * Parses the request head at the start of `data`. On COMPLETE, `req`
+ * describes the request and req->head_len is the number of bytes consumed
+ * (any body follows).
+ */
+inline HttpParse http_parse_request(const char* data, size_t len,
+                                    HttpRequest* req) {
+  const char* end = data + len;
+  const char* p = data;
+
+  // Request line: METHOD SP target SP HTTP/1.x CRLF
+  const char* line_end =
+      static_cast<const char*>(memchr(p, '\n', len));
+  if (!line_end) {
+    return len > HTTP_MAX_HEAD_SIZE ? HttpParse::INVALID
+                                    : HttpParse::INCOMPLETE;
+  }
+
+  const char* sp = static_cast<const char*>(memchr(p, ' ', line_end - p));
+  if (!sp || sp == p) return HttpParse::INVALID;
+  req->method = p;
+  req->method_len = sp - p;
+
+  p = sp + 1;
+  sp = static_cast<const char*>(memchr(p, ' ', line_end - p));
+  if (!sp || sp == p) return HttpParse::INVALID;
+  const char* target_end = sp;
+  const char* q = static_cast<const char*>(memchr(p, '?', target_end - p));
+  req->path = p;
+  req->path_len = (q ? q : target_end) - p;
+  req->query = q ? q + 1 : target_end;
+  req->query_len = q ? target_end - (q + 1) : 0;
+
+  p = sp + 1;
+  const char* version_end = line_end;
+  if (version_end > p && version_end[-1] == '\r') --version_end;
+  if (version_end - p != 8 || memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' ||
+      p[7] > '9') {
+    return HttpParse::INVALID;
+  }
+  req->minor_version = p[7] - '0';
+  req->keep_alive = req->minor_version >= 1;
+  req->chunked = false;
+  req->content_length = 0;
+
+  // Header fields until the empty line
+  p = line_end + 1;
+  while (true) {
+    line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!line_end) {
+      return len > HTTP_MAX_HEAD_SIZE ? HttpParse::INVALID
+                                      : HttpParse::INCOMPLETE;
+    }
+    const char* field_end = line_end;
+    if (field_end > p && field_end[-1] == '\r') --field_end;
+    if (field_end == p) {
+      req->head_len = line_end + 1 - data;
+      return req->head_len > HTTP_MAX_HEAD_SIZE ? HttpParse::INVALID
+                                                : HttpParse::COMPLETE;
+    }
+
+    const char* colon =
+        static_cast<const char*>(memchr(p, ':', field_end - p));
+    if (!colon || colon == p) return HttpParse::INVALID;
+    const char* value = colon + 1;
+    while (value < field_end && (*value == ' ' || *value == '\t')) ++value;
+    size_t value_len = field_end - value;
+    while (value_len > 0 &&
+           (value[value_len - 1] == ' ' || value[value_len - 1] == '\t')) {
+      --value_len;
+    }
+
+    size_t name_len = colon - p;
+    if (http_token_equals(p, name_len, "connection")) {
+      if (http_value_has_token(value, value_len, "close")) {
+        req->keep_alive = false;
+      } else if (http_value_has_token(value, value_len, "keep-alive")) {
+        req->keep_alive = true;
+      }
+    } else if (http_token_equals(p, name_len, "content-length")) {
+      size_t n = 0;
+      if (value_len == 0 || value_len > 9) return HttpParse::INVALID;
+      for (size_t i = 0; i < value_len; ++i) {
+        if (value[i] < '0' || value[i] > '9') return HttpParse::INVALID;
+        n = n * 10 + (value[i] - '0');
+      }
+      req->content_length = n;
+    } else if (http_token_equals(p, name_len, "transfer-encoding")) {
+      req->chunked = true;  // Not supported for requests to this endpoint
+    }
+
+    p = line_end + 1;
+  }
+}
+
+/**
+ * Finds `name` in an application/x-www-form-urlencoded query string.
+ * Values are returned as-is; the endpoint's parameters never need
+ * percent-decoding.
+ */
+inline bool http_query_param(const char* query, size_t len, const char* name,
+                             const char** value, size_t* value_len) {
+  size_t name_len = strlen(name);
+  const char* end = query + len;
+  const char* p = query;
+  while (p < end) {
+    const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+    const char* pair_end = amp ? amp : end;
+    const char* eq = static_cast<const char*>(memchr(p, '=', pair_end - p));
+    const char* key_end = eq ? eq : pair_end;
+    if (static_cast<size_t>(key_end - p) == name_len &&
+        memcmp(p, name, name_len) == 0) {
+      *value = eq ? eq + 1 : pair_end;
+      *value_len = pair_end - *value;
+      return true;
+    }
+    p = pair_end + 1;
+  }
+  return false;
+}
+
+#endif  // HTTP_PARSER_H
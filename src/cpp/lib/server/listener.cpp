@@ -0,0 +1,92 @@
+#include "listener.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+
+#include "../protocol/unix_address.h"
+
+using namespace std;
+
+int create_tcp_listener(int port, int backlog) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("Socket creation failed");
+    return -1;
+  }
+
+  // Allow reuse of address and port to prevent "Address already in use"
+  // errors. The options are separate names and must be set one at a time.
+  int opt = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+    perror("setsockopt failed");
+    close(fd);
+    return -1;
+  }
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+
+  if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    perror("Bind failed");
+    close(fd);
+    return -1;
+  }
+
+  if (listen(fd, backlog) < 0) {
+    perror("Listen failed");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int create_unix_listener(const string& name, bool seqpacket, int backlog) {
+  struct sockaddr_un address;
+  socklen_t addrlen = make_unix_address(name, &address);
+  if (addrlen == 0) {
+    cerr << "Invalid unix socket name: '" << name << "'" << endl;
+    return -1;
+  }
+
+  int type = seqpacket ? SOCK_SEQPACKET : SOCK_STREAM;
+  int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("Unix socket creation failed");
+    return -1;
+  }
+
+  bool abstract = name[0] == '@';
+  if (!abstract) {
+    // A previous sidecar instance may have left its socket file behind
+    unlink(name.c_str());
+  }
+
+  if (bind(fd, (struct sockaddr*)&address, addrlen) < 0) {
+    perror("Unix socket bind failed");
+    close(fd);
+    return -1;
+  }
+
+  // The app container usually runs as a different user
+  if (!abstract && chmod(name.c_str(), 0666) < 0) {
+    perror("chmod on unix socket failed");
+  }
+
+  if (listen(fd, backlog) < 0) {
+    perror("Listen failed");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
@@ -0,0 +1,25 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <string>
+
+/**
+ * Creates a non-blocking TCP socket bound to INADDR_ANY:port and starts
+ * listening with the given backlog.
+ *
+ * @return The listening file descriptor, or -1 on failure (errors are
+ * reported with perror).
+ */
+int create_tcp_listener(int port, int backlog);
+
+/**
+ * Creates a non-blocking AF_UNIX listener (SOCK_STREAM, or SOCK_SEQPACKET
+ * when `seqpacket` is set). Names starting with '@' are bound in the
+ * abstract namespace; filesystem paths replace any stale socket file and are
+ * made connectable by other containers in the pod.
+ *
+ * @return The listening file descriptor, or -1 on failure.
+ */
+int create_unix_listener(const std::string& name, bool seqpacket, int backlog);
+
+#endif  // LISTENER_H
@@ -0,0 +1,71 @@
+#include "server_config.h"
+
+#include <sched.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static int env_int(const char* name, int default_value) {
+  return getenv(name) ? atoi(getenv(name)) : default_value;
+}
+
+ServerConfig ServerConfig::from_env() {
+  ServerConfig config;
+
+  string mode = getenv("SERVER_MODE") ? getenv("SERVER_MODE") : "ONESHOT";
+  if (mode == "PERSISTENT") {
+    config.mode = ServerMode::PERSISTENT;
+  } else if (mode != "ONESHOT") {
+    cerr << "Unknown SERVER_MODE '" << mode << "', using ONESHOT" << endl;
+  }
+
+  string backend =
+      getenv("SERVER_BACKEND") ? getenv("SERVER_BACKEND") : "EPOLL";
+  if (backend == "IO_URING") {
+    config.backend = ServerBackend::IO_URING;
+  } else if (backend != "EPOLL") {
+    cerr << "Unknown SERVER_BACKEND '" << backend << "', using EPOLL" << endl;
+  }
+
+  config.port = env_int("SERVER_PORT", config.port);
+  config.backlog = env_int("LISTEN_BACKLOG", config.backlog);
+  config.idle_timeout_ms = env_int("IDLE_TIMEOUT_MS", config.idle_timeout_ms);
+  config.max_connections = env_int("MAX_CONNECTIONS", config.max_connections);
+
+  config.worker_threads = env_int("SERVER_THREADS", config.worker_threads);
+  if (config.worker_threads <= 0) {
+    cpu_set_t cpus;
+    config.worker_threads =
+        sched_getaffinity(0, sizeof(cpus), &cpus) == 0 ? CPU_COUNT(&cpus) : 1;
+  }
+  config.pin_threads = env_int("PIN_THREADS", 1) != 0;
+
+  if (getenv("SIDECAR_UNIX_SOCKET")) {
+    config.unix_socket = getenv("SIDECAR_UNIX_SOCKET");
+  }
+  string socket_type =
+      getenv("SIDECAR_SOCKET_TYPE") ? getenv("SIDECAR_SOCKET_TYPE") : "STREAM";
+  if (socket_type == "SEQPACKET") {
+    config.unix_seqpacket = true;
+  } else if (socket_type != "STREAM") {
+    cerr << "Unknown SIDECAR_SOCKET_TYPE '" << socket_type
+         << "', using STREAM" << endl;
+  }
+
+  if (getenv("SHM_RING_PATH")) {
+    config.shm_ring_path = getenv("SHM_RING_PATH");
+  }
+  config.shm_ring_capacity =
+      env_int("SHM_RING_CAPACITY", config.shm_ring_capacity);
+  if (getenv("CHECKPOINT_PATH")) {
+    config.checkpoint_path = getenv("CHECKPOINT_PATH");
+  }
+  config.checkpoint_interval_ms =
+      env_int("CHECKPOINT_INTERVAL_MS", config.checkpoint_interval_ms);
+  config.metrics_port = env_int("METRICS_PORT", config.metrics_port);
+
+  return config;
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <string>
+
+/**
+ * How the sidecar treats an accepted connection.
+ *
+ * ONESHOT keeps the original contract: write one ID and close the socket.
+ * PERSISTENT keeps the socket open and answers one ID per request line.
+ */
+enum class ServerMode { ONESHOT, PERSISTENT };
+
+/**
+ * Event loop implementation used by every worker: EpollServer, or
+ * UringServer (falls back to epoll if io_uring cannot be set up).
+ */
+enum class ServerBackend { EPOLL, IO_URING };
+
+/**
+ * Sidecar server settings, read from environment variables next to
+ * GENERATOR_TYPE.
+ */
+struct ServerConfig {
+  ServerMode mode = ServerMode::ONESHOT;  // SERVER_MODE
+  ServerBackend backend = ServerBackend::EPOLL;  // SERVER_BACKEND
+  int port = 8080;                        // SERVER_PORT (0 = no TCP)
+  int backlog = 1024;                     // LISTEN_BACKLOG
+  int idle_timeout_ms = 30000;            // IDLE_TIMEOUT_MS (0 = never)
+  int max_connections = 4096;             // MAX_CONNECTIONS (per worker)
+
+  // Worker threads, each with its own SO_REUSEPORT listener and epoll set.
+  // SERVER_THREADS=0 starts one worker per CPU the process may run on.
+  int worker_threads = 1;                 // SERVER_THREADS
+  bool pin_threads = true;                // PIN_THREADS (0 = no pinning)
+
+  // Optional AF_UNIX listener for same-pod clients. A leading '@' selects
+  // the Linux abstract namespace instead of a filesystem path.
+  std::string unix_socket;      // SIDECAR_UNIX_SOCKET
+  bool unix_seqpacket = false;  // SIDECAR_SOCKET_TYPE=SEQPACKET
+
+  // Optional shared-memory ring transport (see shm_ring.h)
+  std::string shm_ring_path;      // SHM_RING_PATH
+  int shm_ring_capacity = 65536;  // SHM_RING_CAPACITY (IDs)
+
+  // Optional crash-safe high-water mark of the time-based generators (see
+  // timestamp_checkpoint.h)
+  std::string checkpoint_path;      // CHECKPOINT_PATH
+  int checkpoint_interval_ms = 50;  // CHECKPOINT_INTERVAL_MS
+
+  // Prometheus scrape port; latency histograms only record when it is set
+  int metrics_port = 0;  // METRICS_PORT (0 = no metrics endpoint)
+
+  static ServerConfig from_env();
+};
+
+#endif  // SERVER_CONFIG_H
@@ -0,0 +1,120 @@
+#include "server_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "epoll_server.h"
+#include "listener.h"
+#include "uring_server.h"
+
+using namespace std;
+
+ServerPool::ServerPool(const vector<IdGenerator*>& generators,
+                       const ServerConfig& config)
+    : generators(generators), config(config) {}
+
+// Pins the calling thread to the index-th CPU in the process affinity mask
+static void pin_to_cpu(int index) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+
+  int count = CPU_COUNT(&allowed);
+  if (count == 0) {
+    return;
+  }
+
+  int target = index % count;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    if (target-- == 0) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+      return;
+    }
+  }
+}
+
+void ServerPool::run() {
+  // AF_UNIX sockets cannot be reuseport-balanced, so one listener is
+  // shared by every worker's epoll set
+  int unix_fd = -1;
+  if (!config.unix_socket.empty()) {
+    unix_fd = create_unix_listener(config.unix_socket, config.unix_seqpacket,
+                                   config.backlog);
+    if (unix_fd < 0) {
+      return;
+    }
+    cout << "Sidecar listening on unix socket " << config.unix_socket << " ("
+         << (config.unix_seqpacket ? "SOCK_SEQPACKET" : "SOCK_STREAM") << ")"
+         << endl;
+  }
+  if (config.port > 0) {
+    cout << "Sidecar listening on port " << config.port << endl;
+  }
+
+  cout << "Serving in "
+       << (config.mode == ServerMode::PERSISTENT ? "persistent" : "one-shot")
+       << " mode with " << generators.size() << " "
+       << (config.backend == ServerBackend::IO_URING ? "io_uring" : "epoll")
+       << " worker thread(s)"
+       << (config.pin_threads && generators.size() > 1 ? " pinned to CPUs"
+                                                       : "")
+       << " (backlog " << config.backlog << ")..." << endl;
+
+  // Shared with the detached workers, which may outlive this call
+  struct StopSignal {
+    mutex mtx;
+    condition_variable cv;
+    bool stopped = false;
+  };
+  auto signal = make_shared<StopSignal>();
+
+  for (size_t i = 0; i < generators.size(); ++i) {
+    IdGenerator* generator = generators[i];
+    bool pin = config.pin_threads && generators.size() > 1;
+    ServerConfig worker_config = config;
+
+    thread([generator, pin, i, worker_config, unix_fd, signal]() {
+      if (pin) {
+        pin_to_cpu(i);
+      }
+
+      // Construct the server on its own (pinned) thread so its memory is
+      // allocated close to the CPU that uses it
+      bool served = false;
+      if (worker_config.backend == ServerBackend::IO_URING) {
+        UringServer server(*generator, worker_config, unix_fd);
+        if (server.init()) {
+          server.run();
+          served = true;
+        } else {
+          cerr << "Worker " << i << " falling back to the epoll backend"
+               << endl;
+        }
+      }
+      if (!served) {
+        EpollServer server(*generator, worker_config, unix_fd);
+        server.run();
+      }
+
+      lock_guard<mutex> lock(signal->mtx);
+      signal->stopped = true;
+      signal->cv.notify_one();
+    }).detach();
+  }
+
+  unique_lock<mutex> lock(signal->mtx);
+  signal->cv.wait(lock, [&signal] { return signal->stopped; });
+  cerr << "A server worker stopped unexpectedly" << endl;
+}
@@ -0,0 +1,33 @@
+#ifndef SERVER_POOL_H
+#define SERVER_POOL_H
+
+#include <vector>
+
+#include "../id_generator.h"
+#include "server_config.h"
+
+/**
+ * Runs config.worker_threads servers (EpollServer or UringServer, per
+ * config.backend), one per thread.
+ *
+ * Every worker binds its own SO_REUSEPORT TCP listener, so the kernel
+ * spreads incoming connections across them without a shared accept lock.
+ * When pinning is enabled, worker i runs on the i-th CPU the process is
+ * allowed to use. Each worker serves IDs from generators[i], which lets
+ * clock-based generators give every worker its own sequence slice; other
+ * generators simply pass the same instance for all workers.
+ */
+class ServerPool {
+ private:
+  std::vector<IdGenerator*> generators;
+  ServerConfig config;
+
+ public:
+  ServerPool(const std::vector<IdGenerator*>& generators,
+             const ServerConfig& config);
+
+  // Starts the workers. Only returns if one of them stops on a fatal error.
+  void run();
+};
+
+#endif  // SERVER_POOL_H
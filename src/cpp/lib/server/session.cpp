@@ -0,0 +1,516 @@
+#include "session.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+using namespace std;
+
+Session::Session(IdGenerator& generator) : generator(generator) {}
+
+// A connection whose first bytes match one of these speaks HTTP. Methods
+// other than GET are recognised only to answer them with 405.
+static const char* const HTTP_METHODS[] = {"GET ",    "HEAD ",   "POST ",
+                                           "PUT ",    "DELETE ", "OPTIONS ",
+                                           "PATCH "};
+
+bool Session::on_data(const char* data, size_t len, string& out) {
+  if (len == 0) {
+    return true;
+  }
+
+  if (protocol == Protocol::UNKNOWN) {
+    in.append(data, len);
+    protocol = detect_protocol();
+    if (protocol == Protocol::UNKNOWN) {
+      return true;  // Too few bytes to tell yet
+    }
+
+    // Replay the buffered bytes through the chosen protocol
+    string first;
+    first.swap(in);
+    return on_data(first.data(), first.size(), out);
+  }
+
+  if (protocol == Protocol::BINARY) {
+    return handle_frames(data, len, out);
+  }
+  if (protocol == Protocol::HTTP) {
+    return handle_http(data, len, out);
+  }
+  return handle_line(data, len, out);
+}
+
+Session::Protocol Session::detect_protocol() const {
+  if (static_cast<uint8_t>(in[0]) == WIRE_MAGIC) {
+    return Protocol::BINARY;
+  }
+
+  bool partial_match = false;
+  for (const char* method : HTTP_METHODS) {
+    size_t method_len = strlen(method);
+    size_t n = min(in.size(), method_len);
+    if (memcmp(in.data(), method, n) == 0) {
+      if (n == method_len) return Protocol::HTTP;
+      partial_match = true;
+    }
+  }
+  return partial_match ? Protocol::UNKNOWN : Protocol::LINE;
+}
+
+bool Session::handle_line(const char* data, size_t len, string& out) {
+  const char* end = data + len;
+  const char* p = data;
+
+  // Answer every complete request line. A partial line needs no buffering
+  // because its contents are never inspected.
+  while ((p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+    try {
+      if (generator.kind() == IdKind::UUID128) {
+        Uuid128 id = generator.next_id128();
+        if (id.is_nil()) return false;
+        append_uuid_text(id, out);
+      } else {
+        out += generator.next_id_string();
+      }
+    } catch (const exception& e) {
+      return false;  // The line protocol has no way to report errors
+    }
+    out += '\n';
+    ++p;
+  }
+
+  return true;
+}
+
+bool Session::handle_frames(const char* data, size_t len, string& out) {
+  in.append(data, len);
+
+  size_t pos = 0;
+  bool keep_open = true;
+  while (keep_open && in.size() - pos >= WIRE_HEADER_SIZE) {
+    const uint8_t* frame = reinterpret_cast<const uint8_t*>(in.data() + pos);
+    WireHeader request = wire_decode_header(frame);
+
+    // A corrupt header means we can no longer find frame boundaries
+    if (request.magic != WIRE_MAGIC) {
+      append_error(STATUS_BAD_REQUEST, FORMAT_NATIVE, out);
+      keep_open = false;
+      break;
+    }
+    if (request.version != WIRE_VERSION) {
+      append_error(STATUS_BAD_VERSION, FORMAT_NATIVE, out);
+      keep_open = false;
+      break;
+    }
+    if (request.length > WIRE_MAX_REQUEST_PAYLOAD) {
+      append_error(STATUS_BAD_REQUEST, FORMAT_NATIVE, out);
+      keep_open = false;
+      break;
+    }
+
+    if (in.size() - pos < WIRE_HEADER_SIZE + request.length) {
+      break;  // Wait for the rest of the payload
+    }
+
+    keep_open = answer_frame(request, frame + WIRE_HEADER_SIZE, out);
+    pos += WIRE_HEADER_SIZE + request.length;
+  }
+
+  in.erase(0, pos);
+  return keep_open;
+}
+
+bool Session::answer_frame(const WireHeader& request, const uint8_t* payload,
+                           string& out) {
+  if (!set_tag(reinterpret_cast<const char*>(payload), request.length)) {
+    append_error(STATUS_BAD_REQUEST, request.format, out);
+    return true;
+  }
+  if (request.count > WIRE_MAX_COUNT) {
+    append_error(STATUS_COUNT_TOO_LARGE, request.format, out);
+    return true;
+  }
+
+  WireStatus status = append_ids(request.format, request.count, out);
+  if (status != STATUS_OK) {
+    append_error(status, request.format, out);
+  }
+  return true;
+}
+
+// Selects the sequence for the current request. Fails for a malformed tag
+// or one the generator cannot serve.
+bool Session::set_tag(const char* value, size_t len) {
+  if (len > WIRE_MAX_TAG_SIZE || (len > 0 && !generator.supports_tags())) {
+    return false;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    char c = value[i];
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '.' &&
+        c != ':' && c != '-') {
+      return false;
+    }
+  }
+  tag.assign(value, len);
+  return true;
+}
+
+// Fills `ids` (or `uuids` when `wide`) with one batch from the generator,
+// drawn from `tag`'s sequence. Throws if the batch is short.
+void Session::generate_batch(uint32_t count, bool wide) {
+  size_t n;
+  if (wide) {
+    uuids.resize(count);
+    n = generator.next_ids128(uuids.data(), count);
+  } else {
+    ids.resize(count);
+    n = tag.empty() ? generator.next_ids(ids.data(), count)
+                    : generator.next_ids_for(tag, ids.data(), count);
+  }
+  if (n != count) {
+    throw runtime_error("Generator failed mid-batch");
+  }
+}
+
+void Session::append_uuid_text(const Uuid128& id, string& out) {
+  size_t pos = out.size();
+  out.resize(pos + UUID_TEXT_SIZE);
+  format_uuid(id, &out[pos]);
+}
+
+uint8_t Session::resolve_format(uint8_t format) const {
+  IdKind kind = generator.kind();
+  if (format == FORMAT_NATIVE) {
+    format = kind == IdKind::INT64     ? FORMAT_U64
+             : kind == IdKind::UUID128 ? FORMAT_U128
+                                       : FORMAT_TEXT;
+  }
+
+  if ((format == FORMAT_U64 && kind != IdKind::INT64) ||
+      (format == FORMAT_U128 && kind != IdKind::UUID128) ||
+      (format != FORMAT_U64 && format != FORMAT_U128 &&
+       format != FORMAT_TEXT)) {
+    return FORMAT_NATIVE;  // Unsupported
+  }
+  return format;
+}
+
+WireStatus Session::append_ids(uint8_t format, uint32_t count, string& out) {
+  format = resolve_format(format);
+  if (format == FORMAT_NATIVE) {
+    return STATUS_UNSUPPORTED_FORMAT;
+  }
+
+  size_t header_pos = out.size();
+  out.resize(header_pos + WIRE_HEADER_SIZE);
+
+  WireStatus status = append_payload(format, count, out);
+  if (status != STATUS_OK) {
+    out.resize(header_pos);
+    return status;
+  }
+
+  WireHeader response;
+  response.format = format;
+  response.count = count;
+  response.length =
+      static_cast<uint32_t>(out.size() - header_pos - WIRE_HEADER_SIZE);
+  wire_encode_header(response, reinterpret_cast<uint8_t*>(&out[header_pos]));
+  return STATUS_OK;
+}
+
+WireStatus Session::append_payload(uint8_t format, uint32_t count,
+                                   string& out) {
+  size_t payload_pos = out.size();
+
+  try {
+    if (format == FORMAT_U64 || format == FORMAT_U128) {
+      size_t width = format == FORMAT_U64 ? 8 : 16;
+      out.resize(payload_pos + width * count);
+      uint8_t* p = reinterpret_cast<uint8_t*>(&out[payload_pos]);
+
+      generate_batch(count, format == FORMAT_U128);
+      if (format == FORMAT_U64) {
+        for (uint32_t i = 0; i < count; ++i, p += width) {
+          wire_put_le64(p, ids[i]);
+        }
+      } else {
+        for (uint32_t i = 0; i < count; ++i, p += width) {
+          uuids[i].to_bytes(p);
+        }
+      }
+    } else if (generator.kind() == IdKind::UUID128) {
+      generate_batch(count, true);
+      uint8_t len_bytes[2];
+      wire_put_le16(len_bytes, static_cast<uint16_t>(UUID_TEXT_SIZE));
+      for (uint32_t i = 0; i < count; ++i) {
+        out.append(reinterpret_cast<const char*>(len_bytes), 2);
+        append_uuid_text(uuids[i], out);
+      }
+    } else if (generator.kind() == IdKind::INT64) {
+      // One batch from `tag`'s sequence, like FORMAT_U64
+      generate_batch(count, false);
+      char digits[DECIMAL_MAX_SIZE];
+      uint8_t len_bytes[2];
+      for (uint32_t i = 0; i < count; ++i) {
+        size_t len = format_decimal(ids[i], digits);
+        wire_put_le16(len_bytes, static_cast<uint16_t>(len));
+        out.append(reinterpret_cast<const char*>(len_bytes), 2);
+        out.append(digits, len);
+      }
+    } else {
+      for (uint32_t i = 0; i < count; ++i) {
+        string id_str = generator.next_id_string();
+        if (id_str.empty() || id_str.size() > UINT16_MAX) {
+          throw runtime_error("Generator returned an unusable string");
+        }
+        uint8_t len_bytes[2];
+        wire_put_le16(len_bytes, static_cast<uint16_t>(id_str.size()));
+        out.append(reinterpret_cast<const char*>(len_bytes), 2);
+        out += id_str;
+      }
+    }
+  } catch (const exception& e) {
+    // Never hand out a partial batch
+    out.resize(payload_pos);
+    return STATUS_GENERATION_FAILED;
+  }
+
+  return STATUS_OK;
+}
+
+void Session::append_error(WireStatus status, uint8_t format, string& out) {
+  WireHeader response;
+  response.format = format;
+  response.status = status;
+
+  uint8_t buffer[WIRE_HEADER_SIZE];
+  wire_encode_header(response, buffer);
+  out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer));
+}
+
+// Preformatted HTTP response heads, completed with the Content-Length
+static const char HTTP_OK_TEXT[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: ";
+static const char HTTP_OK_JSON[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: ";
+static const char HTTP_OK_BINARY[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+    "Content-Length: ";
+
+static void append_http_response(const char* head, size_t head_len,
+                                 const string& body, bool keep_alive,
+                                 string& out) {
+  char digits[DECIMAL_MAX_SIZE];
+  out.append(head, head_len);
+  out.append(digits, format_decimal(body.size(), digits));
+  if (!keep_alive) {
+    out += "\r\nConnection: close";
+  }
+  out += "\r\n\r\n";
+  out += body;
+}
+
+static void append_http_error(const char* status, bool keep_alive,
+                              string& out) {
+  char digits[DECIMAL_MAX_SIZE];
+  size_t status_len = strlen(status);
+  out += "HTTP/1.1 ";
+  out.append(status, status_len);
+  out += "\r\nContent-Type: text/plain\r\nContent-Length: ";
+  out.append(digits, format_decimal(status_len + 1, digits));
+  if (!keep_alive) {
+    out += "\r\nConnection: close";
+  }
+  out += "\r\n\r\n";
+  out.append(status, status_len);
+  out += '\n';
+}
+
+bool Session::handle_http(const char* data, size_t len, string& out) {
+  // Parse straight from the read buffer unless a partial request is pending
+  const char* buf = data;
+  size_t buf_len = len;
+  if (!in.empty()) {
+    in.append(data, len);
+    buf = in.data();
+    buf_len = in.size();
+  }
+
+  size_t pos = 0;
+  bool keep_open = true;
+  while (keep_open && pos < buf_len) {
+    HttpRequest request;
+    HttpParse result = http_parse_request(buf + pos, buf_len - pos, &request);
+    if (result == HttpParse::INCOMPLETE) {
+      break;
+    }
+    if (result == HttpParse::INVALID || request.chunked) {
+      append_http_error("400 Bad Request", false, out);
+      keep_open = false;
+      break;
+    }
+    if (request.content_length > WIRE_MAX_REQUEST_PAYLOAD) {
+      append_http_error("413 Payload Too Large", false, out);
+      keep_open = false;
+      break;
+    }
+
+    // A request body is allowed but ignored
+    size_t total = request.head_len + request.content_length;
+    if (buf_len - pos < total) {
+      break;
+    }
+
+    keep_open = answer_http(request, out);
+    pos += total;
+  }
+
+  if (!keep_open) {
+    in.clear();
+  } else if (buf == data) {
+    in.assign(data + pos, len - pos);
+  } else {
+    in.erase(0, pos);
+  }
+  return keep_open;
+}
+
+bool Session::answer_http(const HttpRequest& request, string& out) {
+  bool keep_alive = request.keep_alive;
+
+  // Method names are case-sensitive
+  if (request.method_len != 3 || memcmp(request.method, "GET", 3) != 0) {
+    append_http_error("405 Method Not Allowed", keep_alive, out);
+    return keep_alive;
+  }
+  if (request.path_len != 3 || memcmp(request.path, "/id", 3) != 0) {
+    append_http_error("404 Not Found", keep_alive, out);
+    return keep_alive;
+  }
+
+  const char* value = nullptr;
+  size_t value_len = 0;
+
+  uint32_t count = 1;
+  if (http_query_param(request.query, request.query_len, "count", &value,
+                       &value_len)) {
+    uint64_t n = 0;
+    bool valid = value_len > 0 && value_len <= 9;
+    for (size_t i = 0; valid && i < value_len; ++i) {
+      valid = value[i] >= '0' && value[i] <= '9';
+      n = n * 10 + (value[i] - '0');
+    }
+    if (!valid || n == 0 || n > WIRE_MAX_COUNT) {
+      append_http_error("400 Bad Request", keep_alive, out);
+      return keep_alive;
+    }
+    count = static_cast<uint32_t>(n);
+  }
+
+  bool tagged = http_query_param(request.query, request.query_len, "tag",
+                                 &value, &value_len);
+  if (!set_tag(value, tagged ? value_len : 0)) {
+    append_http_error("400 Bad Request", keep_alive, out);
+    return keep_alive;
+  }
+
+  enum { TEXT, JSON, U64, U128 } format = TEXT;
+  if (http_query_param(request.query, request.query_len, "format", &value,
+                       &value_len)) {
+    if (value_len == 4 && memcmp(value, "text", 4) == 0) {
+      format = TEXT;
+    } else if (value_len == 4 && memcmp(value, "json", 4) == 0) {
+      format = JSON;
+    } else if (value_len == 3 && memcmp(value, "u64", 3) == 0) {
+      format = U64;
+    } else if (value_len == 4 && memcmp(value, "u128", 4) == 0) {
+      format = U128;
+    } else {
+      append_http_error("400 Bad Request", keep_alive, out);
+      return keep_alive;
+    }
+  }
+
+  body.clear();
+  WireStatus status;
+  if (format == U64 || format == U128) {
+    uint8_t wire_format = format == U64 ? FORMAT_U64 : FORMAT_U128;
+    status = resolve_format(wire_format) == wire_format
+                 ? append_payload(wire_format, count, body)
+                 : STATUS_UNSUPPORTED_FORMAT;
+  } else {
+    status = append_text_ids(count, format == JSON, body);
+  }
+
+  if (status == STATUS_UNSUPPORTED_FORMAT) {
+    append_http_error("400 Bad Request", keep_alive, out);
+  } else if (status != STATUS_OK) {
+    append_http_error("503 Service Unavailable", keep_alive, out);
+  } else if (format == JSON) {
+    append_http_response(HTTP_OK_JSON, sizeof(HTTP_OK_JSON) - 1, body,
+                         keep_alive, out);
+  } else if (format == TEXT) {
+    append_http_response(HTTP_OK_TEXT, sizeof(HTTP_OK_TEXT) - 1, body,
+                         keep_alive, out);
+  } else {
+    append_http_response(HTTP_OK_BINARY, sizeof(HTTP_OK_BINARY) - 1, body,
+                         keep_alive, out);
+  }
+  return keep_alive;
+}
+
+WireStatus Session::append_text_ids(uint32_t count, bool json, string& out) {
+  // JSON carries IDs as strings: 64-bit values do not survive a round trip
+  // through a JavaScript number
+  size_t start = out.size();
+  if (json) out += "{\"ids\":[";
+
+  IdKind kind = generator.kind();
+  char digits[DECIMAL_MAX_SIZE];
+  try {
+    if (kind != IdKind::TEXT) {
+      generate_batch(count, kind == IdKind::UUID128);
+    }
+
+    // Plain text is newline-separated: format the batch in one pass
+    if (!json && kind != IdKind::TEXT) {
+      size_t pos = out.size();
+      if (kind == IdKind::INT64) {
+        out.resize(pos + count * (DECIMAL_MAX_SIZE + 1));
+        out.resize(pos + format_decimal_batch(ids.data(), count, '\n',
+                                              &out[pos]));
+      } else {
+        out.resize(pos + count * (UUID_TEXT_SIZE + 1));
+        out.resize(pos + format_uuid_batch(uuids.data(), count, '\n',
+                                           &out[pos]));
+      }
+      return STATUS_OK;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      if (json) out += i == 0 ? "\"" : ",\"";
+      if (kind == IdKind::INT64) {
+        out.append(digits, format_decimal(ids[i], digits));
+      } else if (kind == IdKind::UUID128) {
+        append_uuid_text(uuids[i], out);
+      } else {
+        string id_str = generator.next_id_string();
+        if (id_str.empty()) {
+          throw runtime_error("Generator returned an empty string");
+        }
+        out += id_str;
+      }
+      out += json ? '"' : '\n';
+    }
+  } catch (const exception& e) {
+    out.resize(start);
+    return STATUS_GENERATION_FAILED;
+  }
+
+  if (json) out += "]}\n";
+  return STATUS_OK;
+}
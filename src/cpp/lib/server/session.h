@@ -0,0 +1,63 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../id_generator.h"
+#include "../protocol/wire_protocol.h"
+#include "http_parser.h"
+
+/**
+ * Per-connection protocol state for persistent connections.
+ *
+ * The transport feeds every chunk it reads into on_data() and writes back
+ * whatever was appended to `out`. The protocol is picked from the first
+ * byte a client sends:
+ *
+ * - WIRE_MAGIC starts the binary batch protocol (see wire_protocol.h).
+ * - An HTTP method ("GET ", "POST ", ...) starts HTTP/1.1, served as
+ *   `GET /id?count=N&format=text|json|u64|u128&tag=T` with keep-alive
+ *   and pipelining (see http_parser.h).
+ * - Anything else is the line protocol: each '\n'-terminated request line
+ *   is answered with one ID followed by '\n'; line contents are ignored.
+ */
+class Session {
+ private:
+  enum class Protocol { UNKNOWN, LINE, BINARY, HTTP };
+
+  IdGenerator& generator;
+  Protocol protocol = Protocol::UNKNOWN;
+  std::string in;    // Unconsumed bytes of a partial frame or request
+  std::string body;  // Reused buffer for HTTP response bodies
+  std::vector<uint64_t> ids;  // Reused buffers for batches from the generator
+  std::vector<Uuid128> uuids;
+  std::string tag;  // Sequence of the request being answered; empty: default
+
+  bool set_tag(const char* value, size_t len);
+  void generate_batch(uint32_t count, bool wide);
+  void append_uuid_text(const Uuid128& id, std::string& out);
+
+  Protocol detect_protocol() const;
+  bool handle_line(const char* data, size_t len, std::string& out);
+  bool handle_frames(const char* data, size_t len, std::string& out);
+  bool answer_frame(const WireHeader& request, const uint8_t* payload,
+                    std::string& out);
+  bool handle_http(const char* data, size_t len, std::string& out);
+  bool answer_http(const HttpRequest& request, std::string& out);
+  uint8_t resolve_format(uint8_t format) const;
+  WireStatus append_ids(uint8_t format, uint32_t count, std::string& out);
+  WireStatus append_payload(uint8_t format, uint32_t count, std::string& out);
+  WireStatus append_text_ids(uint32_t count, bool json, std::string& out);
+  void append_error(WireStatus status, uint8_t format, std::string& out);
+
+ public:
+  explicit Session(IdGenerator& generator);
+
+  // Returns false if the connection should be closed once `out` is sent.
+  bool on_data(const char* data, size_t len, std::string& out);
+};
+
+#endif  // SESSION_H
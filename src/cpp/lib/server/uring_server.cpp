@@ -0,0 +1,678 @@
+#include "uring_server.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "listener.h"
+
+using namespace std;
+
+// The pieces of the io_uring ABI newer than the oldest kernel headers we
+// build against (Ubuntu 22.04 ships 5.15 headers). Layouts and values are
+// fixed by the kernel ABI.
+#ifndef IORING_ACCEPT_MULTISHOT
+#define IORING_ACCEPT_MULTISHOT (1U << 0)
+#endif
+#ifndef IORING_RECV_MULTISHOT
+#define IORING_RECV_MULTISHOT (1U << 1)
+#endif
+#ifndef IORING_ASYNC_CANCEL_ALL
+#define IORING_ASYNC_CANCEL_ALL (1U << 0)
+#endif
+#ifndef IORING_ASYNC_CANCEL_FD
+#define IORING_ASYNC_CANCEL_FD (1U << 1)
+#endif
+
+static const unsigned URING_REGISTER_PBUF_RING = 22;
+
+struct UringBuf {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t bid;
+  uint16_t resv;  // In entry 0 this is the ring tail
+};
+
+struct UringBufReg {
+  uint64_t ring_addr;
+  uint32_t ring_entries;
+  uint16_t bgid;
+  uint16_t flags;
+  uint64_t resv[3];
+};
+
+// Submission and completion queue sizes. Multishot operations post many
+// completions per submission, so the completion queue is larger.
+static const unsigned SQ_ENTRIES = 256;
+static const unsigned CQ_ENTRIES = 4096;
+
+// Provided receive buffers (count must be a power of two)
+static const uint16_t BUF_GROUP = 0;
+static const unsigned BUF_COUNT = 512;
+static const size_t BUF_SIZE = 4096;
+
+// How often idle connections are swept
+static const int SWEEP_INTERVAL_MS = 1000;
+
+// Stop receiving from a peer once this many response bytes are queued
+static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+// Largest single message written to a SOCK_SEQPACKET peer
+static const size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
+// Operation tags in the low byte of user_data. The next 32 bits hold the
+// fd (or listener/oneshot index) and the top 24 bits the connection
+// generation, so completions for a closed connection never match a new
+// connection that reuses its descriptor.
+enum UringOp : uint8_t {
+  OP_ACCEPT = 1,
+  OP_RECV,
+  OP_SEND,
+  OP_CLOSE,
+  OP_CANCEL,
+  OP_ONESHOT_SEND,
+  OP_ONESHOT_CLOSE,
+  OP_SWEEP,
+};
+
+static uint64_t pack_user_data(UringOp op, uint32_t index,
+                               uint32_t generation = 0) {
+  return (static_cast<uint64_t>(generation & 0xFFFFFF) << 40) |
+         (static_cast<uint64_t>(index) << 8) | op;
+}
+
+static uint64_t steady_millis() {
+  return chrono::duration_cast<chrono::milliseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+UringServer::UringServer(IdGenerator& generator, const ServerConfig& config,
+                         int shared_unix_fd)
+    : generator(generator),
+      config(config),
+      shared_unix_fd(shared_unix_fd),
+      response_latency(server_response_latency("io_uring")),
+      accepted(server_accepted_counter("io_uring")) {
+  sweep_interval.tv_sec = SWEEP_INTERVAL_MS / 1000;
+  sweep_interval.tv_nsec = (SWEEP_INTERVAL_MS % 1000) * 1000000L;
+}
+
+UringServer::~UringServer() {
+  for (auto& entry : connections) {
+    close(entry.first);
+  }
+  // Closing the ring cancels every outstanding operation
+  if (ring_fd >= 0) {
+    close(ring_fd);
+  }
+  if (sqes) {
+    munmap(sqes, sqes_size);
+  }
+  if (cq_ring && cq_ring != sq_ring) {
+    munmap(cq_ring, cq_ring_size);
+  }
+  if (sq_ring) {
+    munmap(sq_ring, sq_ring_size);
+  }
+  if (buf_ring) {
+    munmap(buf_ring, buf_ring_size);
+  }
+  if (buffers) {
+    munmap(buffers, buffers_size);
+  }
+  for (const Listener& listener : listeners) {
+    if (listener.owned) {
+      close(listener.fd);
+    }
+  }
+}
+
+bool UringServer::init() {
+  return setup_ring() && setup_buffers() && open_listeners();
+}
+
+bool UringServer::open_listeners() {
+  if (config.port > 0) {
+    int fd = create_tcp_listener(config.port, config.backlog);
+    if (fd < 0) return false;
+    listeners.push_back({fd, true, false, true});
+  }
+
+  if (shared_unix_fd >= 0) {
+    listeners.push_back({shared_unix_fd, false, config.unix_seqpacket, false});
+  }
+
+  if (listeners.empty()) {
+    cerr << "No listener configured (SERVER_PORT=0 and no SIDECAR_UNIX_SOCKET)"
+         << endl;
+    return false;
+  }
+  return true;
+}
+
+bool UringServer::setup_ring() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = CQ_ENTRIES;
+
+  ring_fd = syscall(__NR_io_uring_setup, SQ_ENTRIES, &params);
+  if (ring_fd < 0) {
+    cerr << "io_uring_setup failed: " << strerror(errno) << endl;
+    return false;
+  }
+
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size = cq_ring_size = max(sq_ring_size, cq_ring_size);
+  }
+
+  sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    sq_ring = nullptr;
+    perror("Failed to map io_uring submission queue");
+    return false;
+  }
+
+  if (single_mmap) {
+    cq_ring = sq_ring;
+  } else {
+    cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      cq_ring = nullptr;
+      perror("Failed to map io_uring completion queue");
+      return false;
+    }
+  }
+
+  sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* p = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (p == MAP_FAILED) {
+    perror("Failed to map io_uring submission entries");
+    return false;
+  }
+  sqes = static_cast<struct io_uring_sqe*>(p);
+
+  char* sq = static_cast<char*>(sq_ring);
+  sq_head = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+  sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+  sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+  sq_entries = params.sq_entries;
+  sqe_tail = *sq_tail;
+
+  char* cq = static_cast<char*>(cq_ring);
+  cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+  cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+bool UringServer::setup_buffers() {
+  buf_ring_size = BUF_COUNT * sizeof(UringBuf);
+  buf_ring = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf_ring == MAP_FAILED) {
+    buf_ring = nullptr;
+    perror("Failed to allocate io_uring buffer ring");
+    return false;
+  }
+
+  buffers_size = BUF_COUNT * BUF_SIZE;
+  void* p = mmap(nullptr, buffers_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    perror("Failed to allocate io_uring receive buffers");
+    return false;
+  }
+  buffers = static_cast<char*>(p);
+
+  UringBufReg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+  reg.ring_entries = BUF_COUNT;
+  reg.bgid = BUF_GROUP;
+  if (syscall(__NR_io_uring_register, ring_fd, URING_REGISTER_PBUF_RING, &reg,
+              1) < 0) {
+    cerr << "io_uring provided buffer rings are unavailable (Linux 5.19+): "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  for (unsigned i = 0; i < BUF_COUNT; ++i) {
+    recycle_buffer(i);
+  }
+  return true;
+}
+
+void UringServer::recycle_buffer(uint16_t bid) {
+  UringBuf* ring = static_cast<UringBuf*>(buf_ring);
+  // Assign field by field: entry 0's `resv` is the shared tail
+  UringBuf& entry = ring[buf_tail & (BUF_COUNT - 1)];
+  entry.addr = reinterpret_cast<uint64_t>(buffers + bid * BUF_SIZE);
+  entry.len = BUF_SIZE;
+  entry.bid = bid;
+  ++buf_tail;
+  __atomic_store_n(&ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+}
+
+bool UringServer::reserve_sqes(uint32_t count) {
+  if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) + count <=
+      sq_entries) {
+    return true;
+  }
+  // Full: hand the queued entries to the kernel now instead of waiting for
+  // the end of this batch of completions
+  if (!flush_submissions()) {
+    return false;
+  }
+  return sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) + count <=
+         sq_entries;
+}
+
+struct io_uring_sqe* UringServer::get_sqe() {
+  if (!reserve_sqes(1)) {
+    cerr << "io_uring submission queue is stuck" << endl;
+    ring_failed = true;
+    return nullptr;
+  }
+  uint32_t index = sqe_tail & sq_mask;
+  struct io_uring_sqe* sqe = &sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sq_array[index] = index;
+  ++sqe_tail;
+  return sqe;
+}
+
+bool UringServer::flush_submissions() {
+  __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+  while (true) {
+    uint32_t pending = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0) return true;
+    if (syscall(__NR_io_uring_enter, ring_fd, pending, 0, 0, nullptr, 0) < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EBUSY) return true;
+      perror("io_uring_enter failed");
+      return false;
+    }
+  }
+}
+
+bool UringServer::submit_and_wait() {
+  __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+  uint32_t pending = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+  if (syscall(__NR_io_uring_enter, ring_fd, pending, 1,
+              IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return true;
+    perror("io_uring_enter failed");
+    return false;
+  }
+  return true;
+}
+
+void UringServer::run() {
+  for (size_t i = 0; i < listeners.size(); ++i) {
+    arm_accept(i);
+  }
+  if (config.mode == ServerMode::PERSISTENT && config.idle_timeout_ms > 0) {
+    arm_sweep_timer();
+  }
+
+  while (!ring_failed) {
+    if (!submit_and_wait()) {
+      return;
+    }
+
+    uint32_t head = *cq_head;
+    uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail && !ring_failed) {
+      struct io_uring_cqe cqe = cqes[head & cq_mask];
+      // Release the slot before handling, which may submit more work
+      __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+      handle_completion(cqe);
+    }
+  }
+}
+
+void UringServer::handle_completion(const struct io_uring_cqe& cqe) {
+  UringOp op = static_cast<UringOp>(cqe.user_data & 0xFF);
+  uint32_t index = static_cast<uint32_t>(cqe.user_data >> 8);
+  uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 40);
+
+  switch (op) {
+    case OP_ACCEPT:
+      on_accept(index, cqe);
+      return;
+
+    case OP_ONESHOT_SEND: {
+      auto it = oneshot_out.find(index);
+      if (it != oneshot_out.end()) {
+        if (it->second.accepted_ns) {
+          response_latency.record_ns(metrics_now_ns() - it->second.accepted_ns);
+        }
+        oneshot_out.erase(it);
+      }
+      return;
+    }
+
+    case OP_ONESHOT_CLOSE:
+      // The linked close is skipped when the send fails
+      if (cqe.res == -ECANCELED) {
+        close(static_cast<int>(index));
+      }
+      return;
+
+    case OP_SWEEP:
+      close_idle_connections(steady_millis());
+      arm_sweep_timer();
+      return;
+
+    case OP_RECV:
+    case OP_SEND: {
+      auto it = connections.find(static_cast<int>(index));
+      if (it == connections.end() ||
+          (it->second.generation & 0xFFFFFF) != generation) {
+        return;
+      }
+      if (op == OP_RECV) {
+        on_recv(it->second, cqe);
+      } else {
+        on_send(it->second, cqe);
+      }
+      return;
+    }
+
+    case OP_CLOSE:
+    case OP_CANCEL:
+    default:
+      return;
+  }
+}
+
+void UringServer::arm_accept(size_t listener_index) {
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) return;
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listeners[listener_index].fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = pack_user_data(OP_ACCEPT, listener_index);
+}
+
+void UringServer::arm_sweep_timer() {
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) return;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<uint64_t>(&sweep_interval);
+  sqe->len = 1;
+  sqe->user_data = pack_user_data(OP_SWEEP, 0);
+}
+
+void UringServer::on_accept(size_t listener_index,
+                            const struct io_uring_cqe& cqe) {
+  // The multishot accept stays armed until the kernel says otherwise
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    arm_accept(listener_index);
+  }
+
+  if (cqe.res < 0) {
+    if (cqe.res != -ECONNABORTED && cqe.res != -EINTR) {
+      cerr << "Accept failed: " << strerror(-cqe.res) << endl;
+    }
+    return;
+  }
+
+  int fd = cqe.res;
+  const Listener& listener = listeners[listener_index];
+  accepted.inc();
+
+  if (config.mode == ServerMode::ONESHOT) {
+    submit_oneshot(fd);
+    return;
+  }
+
+  if (connections.size() >= static_cast<size_t>(config.max_connections)) {
+    cerr << "Connection limit (" << config.max_connections
+         << ") reached, rejecting client" << endl;
+    close(fd);
+    return;
+  }
+
+  if (listener.is_tcp) {
+    // Responses are tiny; don't let Nagle hold them back
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  }
+
+  auto result = connections.emplace(
+      piecewise_construct, forward_as_tuple(fd),
+      forward_as_tuple(fd, next_generation++, listener.message_mode,
+                       generator));
+  Connection& conn = result.first->second;
+  conn.last_active_ms = steady_millis();
+  arm_recv(conn);
+}
+
+void UringServer::submit_oneshot(int fd) {
+  if (!reserve_sqes(2)) {
+    close(fd);
+    return;
+  }
+
+  // The buffer must outlive the send, so it is kept until its completion
+  uint32_t token = next_oneshot++;
+  OneshotReply& reply = oneshot_out[token];
+  reply.accepted_ns = metrics_enabled ? metrics_now_ns() : 0;
+  reply.id = generator.next_id_string();
+  const string& id_str = reply.id;
+
+  // Send the ID and close the socket in one linked submission
+  struct io_uring_sqe* send_sqe = get_sqe();
+  send_sqe->opcode = IORING_OP_SEND;
+  send_sqe->fd = fd;
+  send_sqe->addr = reinterpret_cast<uint64_t>(id_str.data());
+  send_sqe->len = id_str.length();
+  send_sqe->msg_flags = MSG_NOSIGNAL;
+  send_sqe->flags = IOSQE_IO_LINK;
+  send_sqe->user_data = pack_user_data(OP_ONESHOT_SEND, token);
+
+  struct io_uring_sqe* close_sqe = get_sqe();
+  close_sqe->opcode = IORING_OP_CLOSE;
+  close_sqe->fd = fd;
+  close_sqe->user_data = pack_user_data(OP_ONESHOT_CLOSE, fd);
+}
+
+void UringServer::arm_recv(Connection& conn) {
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) return;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = conn.fd;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUF_GROUP;
+  sqe->ioprio = recv_multishot ? IORING_RECV_MULTISHOT : 0;
+  sqe->user_data = pack_user_data(OP_RECV, conn.fd, conn.generation);
+  conn.recv_armed = true;
+}
+
+void UringServer::on_recv(Connection& conn, const struct io_uring_cqe& cqe) {
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    conn.recv_armed = false;
+    conn.cancel_requested = false;
+  }
+
+  if (cqe.flags & IORING_CQE_F_BUFFER) {
+    uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    if (cqe.res > 0 && !conn.draining && !conn.closing) {
+      conn.last_active_ms = steady_millis();
+      uint64_t read_ns = metrics_enabled ? metrics_now_ns() : 0;
+      // Stop reading after a protocol error, but still deliver the answers
+      // already queued for this peer
+      conn.draining =
+          !conn.session.on_data(buffers + bid * BUF_SIZE, cqe.res, conn.out);
+      if (conn.pending_since_ns == 0 && !conn.out.empty()) {
+        conn.pending_since_ns = read_ns;
+      }
+    }
+    recycle_buffer(bid);
+  }
+
+  if (cqe.res == 0) {
+    conn.draining = true;  // Peer closed its side
+  } else if (cqe.res == -EINVAL && recv_multishot) {
+    cerr << "Multishot recv is unavailable (Linux 6.0+), re-arming "
+            "single-shot receives"
+         << endl;
+    recv_multishot = false;
+  } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+    conn.closing = true;
+  }
+
+  progress(conn);
+}
+
+void UringServer::submit_send(Connection& conn) {
+  if (conn.sending_offset >= conn.sending.size()) {
+    // Everything submitted so far has been sent; take the queued output
+    conn.sending.clear();
+    conn.sending_offset = 0;
+    if (conn.out.empty()) return;
+    conn.sending.swap(conn.out);
+  }
+
+  size_t len = conn.sending.size() - conn.sending_offset;
+  if (conn.message_mode && len > MAX_MESSAGE_SIZE) {
+    len = MAX_MESSAGE_SIZE;
+  }
+
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) return;
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = conn.fd;
+  sqe->addr = reinterpret_cast<uint64_t>(conn.sending.data() +
+                                         conn.sending_offset);
+  sqe->len = len;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = pack_user_data(OP_SEND, conn.fd, conn.generation);
+  conn.send_in_flight = true;
+}
+
+void UringServer::on_send(Connection& conn, const struct io_uring_cqe& cqe) {
+  conn.send_in_flight = false;
+  if (cqe.res < 0) {
+    conn.closing = true;
+  } else {
+    conn.sending_offset += cqe.res;
+    if (conn.pending_since_ns && conn.out.empty() &&
+        conn.sending_offset >= conn.sending.size()) {
+      response_latency.record_ns(metrics_now_ns() - conn.pending_since_ns);
+      conn.pending_since_ns = 0;
+    }
+  }
+  progress(conn);
+}
+
+void UringServer::submit_cancel(Connection& conn, bool recv_only) {
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) return;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  if (recv_only) {
+    sqe->fd = -1;
+    sqe->addr = pack_user_data(OP_RECV, conn.fd, conn.generation);
+  } else {
+    sqe->fd = conn.fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  }
+  sqe->user_data = pack_user_data(OP_CANCEL, conn.fd);
+  if (recv_only) {
+    conn.cancel_requested = true;
+  } else {
+    conn.cancel_all_requested = true;
+  }
+}
+
+void UringServer::submit_close(int fd) {
+  struct io_uring_sqe* sqe = get_sqe();
+  if (!sqe) {
+    close(fd);
+    return;
+  }
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  sqe->user_data = pack_user_data(OP_CLOSE, fd);
+}
+
+void UringServer::progress(Connection& conn) {
+  if (!conn.closing && !conn.send_in_flight) {
+    submit_send(conn);
+  }
+
+  size_t pending =
+      conn.out.size() + conn.sending.size() - conn.sending_offset;
+  if (conn.draining && pending == 0) {
+    conn.closing = true;
+  }
+
+  if (conn.closing) {
+    // The descriptor may only be closed once the kernel is done with it
+    if (conn.recv_armed || conn.send_in_flight) {
+      if (!conn.cancel_all_requested) {
+        submit_cancel(conn, false);
+      }
+      return;
+    }
+    int fd = conn.fd;
+    connections.erase(fd);
+    submit_close(fd);
+    return;
+  }
+
+  if (conn.draining) {
+    return;
+  }
+
+  // Backpressure: stop receiving while a slow reader has too much queued
+  if (pending >= MAX_PENDING_OUTPUT) {
+    if (conn.recv_armed && !conn.cancel_requested) {
+      submit_cancel(conn, true);
+    }
+  } else if (!conn.recv_armed) {
+    arm_recv(conn);
+  }
+}
+
+void UringServer::close_idle_connections(uint64_t now_ms) {
+  vector<int> idle;
+  for (auto& entry : connections) {
+    const Connection& conn = entry.second;
+    if (!conn.closing &&
+        now_ms - conn.last_active_ms >=
+            static_cast<uint64_t>(config.idle_timeout_ms)) {
+      idle.push_back(entry.first);
+    }
+  }
+
+  for (int fd : idle) {
+    Connection& conn = connections.at(fd);
+    conn.closing = true;
+    progress(conn);
+  }
+}
@@ -0,0 +1,161 @@
+#ifndef URING_SERVER_H
+#define URING_SERVER_H
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "server_config.h"
+#include "session.h"
+
+/**
+ * io_uring-driven sidecar server, an alternative to EpollServer selected
+ * with SERVER_BACKEND=IO_URING. It speaks the same protocols through the
+ * same Session class, but replaces per-event syscalls with batched ring
+ * submissions:
+ *
+ * - Every listener has one multishot accept armed; the kernel posts a
+ *   completion per accepted socket without re-submission.
+ * - Persistent connections receive through a multishot recv that picks
+ *   buffers from a provided buffer ring, so no buffer is pinned to an idle
+ *   connection. Buffers go back to the ring as soon as the Session has
+ *   consumed them.
+ * - In ONESHOT mode the ID is sent with a send linked to a close, so one
+ *   submission replaces the original send/close pair.
+ *
+ * All of a worker's submissions since the last wakeup go to the kernel in
+ * a single io_uring_enter() call, which also waits for the next completion.
+ *
+ * The ring is driven through the raw syscalls (liburing is not required).
+ * Multishot accept and buffer rings need Linux 5.19; on 5.19 itself recv
+ * falls back to single-shot receives re-armed after every completion.
+ * init() fails on older kernels, or where io_uring is blocked by seccomp,
+ * so the caller can fall back to EpollServer.
+ */
+class UringServer {
+ private:
+  struct Listener {
+    int fd;
+    bool is_tcp;
+    bool message_mode;
+    bool owned;
+  };
+
+  struct Connection {
+    int fd;
+    uint32_t generation;  // Distinguishes reuses of the same descriptor
+    bool message_mode;
+    Session session;
+    std::string out;       // Queued, not yet submitted output
+    std::string sending;   // Buffer owned by the in-flight send
+    size_t sending_offset = 0;
+    uint64_t last_active_ms = 0;
+    bool recv_armed = false;
+    bool send_in_flight = false;
+    bool cancel_requested = false;  // Recv cancelled for backpressure
+    bool cancel_all_requested = false;  // Everything cancelled for close
+    bool draining = false;  // Close once queued output has been sent
+    bool closing = false;   // Close as soon as no operation is in flight
+    uint64_t pending_since_ns = 0;  // Oldest unanswered request (metrics)
+
+    Connection(int fd, uint32_t generation, bool message_mode,
+               IdGenerator& generator)
+        : fd(fd),
+          generation(generation),
+          message_mode(message_mode),
+          session(generator) {}
+  };
+
+  IdGenerator& generator;
+  ServerConfig config;
+  int shared_unix_fd;
+  std::vector<Listener> listeners;
+  std::unordered_map<int, Connection> connections;
+  struct OneshotReply {
+    std::string id;
+    uint64_t accepted_ns;  // For response latency
+  };
+
+  std::unordered_map<uint32_t, OneshotReply> oneshot_out;  // In-flight sends
+  uint32_t next_oneshot = 0;
+  uint32_t next_generation = 1;
+  bool recv_multishot = true;
+  bool ring_failed = false;
+  LatencyHistogram& response_latency;
+  Counter& accepted;
+
+  // Submission and completion rings shared with the kernel
+  int ring_fd = -1;
+  void* sq_ring = nullptr;
+  size_t sq_ring_size = 0;
+  void* cq_ring = nullptr;
+  size_t cq_ring_size = 0;
+  struct io_uring_sqe* sqes = nullptr;
+  size_t sqes_size = 0;
+  uint32_t* sq_head = nullptr;
+  uint32_t* sq_tail = nullptr;
+  uint32_t* sq_array = nullptr;
+  uint32_t sq_mask = 0;
+  uint32_t sq_entries = 0;
+  uint32_t sqe_tail = 0;  // Next SQE to fill; published to *sq_tail on submit
+  uint32_t* cq_head = nullptr;
+  uint32_t* cq_tail = nullptr;
+  uint32_t cq_mask = 0;
+  struct io_uring_cqe* cqes = nullptr;
+
+  // Provided buffer ring used by recv
+  void* buf_ring = nullptr;
+  size_t buf_ring_size = 0;
+  char* buffers = nullptr;
+  size_t buffers_size = 0;
+  uint16_t buf_tail = 0;
+
+  struct __kernel_timespec sweep_interval = {};
+
+  bool open_listeners();
+  bool setup_ring();
+  bool setup_buffers();
+  bool reserve_sqes(uint32_t count);
+  struct io_uring_sqe* get_sqe();
+  bool flush_submissions();
+  bool submit_and_wait();
+  void recycle_buffer(uint16_t bid);
+
+  void arm_accept(size_t listener_index);
+  void arm_recv(Connection& conn);
+  void arm_sweep_timer();
+  void submit_send(Connection& conn);
+  void submit_oneshot(int fd);
+  void submit_cancel(Connection& conn, bool recv_only);
+  void submit_close(int fd);
+
+  void handle_completion(const struct io_uring_cqe& cqe);
+  void on_accept(size_t listener_index, const struct io_uring_cqe& cqe);
+  void on_recv(Connection& conn, const struct io_uring_cqe& cqe);
+  void on_send(Connection& conn, const struct io_uring_cqe& cqe);
+  void progress(Connection& conn);
+  void close_idle_connections(uint64_t now_ms);
+
+ public:
+  // shared_unix_fd is the AF_UNIX listener created by the caller (or -1)
+  UringServer(IdGenerator& generator, const ServerConfig& config,
+              int shared_unix_fd = -1);
+  ~UringServer();
+  UringServer(const UringServer&) = delete;
+  UringServer& operator=(const UringServer&) = delete;
+
+  // Binds the listeners and sets up the rings. Returns false if io_uring
+  // (or one of the features above) is unavailable.
+  bool init();
+
+  // Runs the event loop. Only returns on a fatal ring error.
+  void run();
+};
+
+#endif  // URING_SERVER_H
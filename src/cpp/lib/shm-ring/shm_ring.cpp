@@ -0,0 +1,233 @@
+#include "shm_ring.h"
+
+#include <sys/file.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+
+#include "../id_generator.h"
+
+using namespace std;
+
+// IDs generated per refill step before they are published to consumers
+static const size_t REFILL_CHUNK = 256;
+
+ShmRingProducer::ShmRingProducer(IdGenerator& generator, const string& path,
+                                 uint64_t capacity)
+    : generator(generator), path(path), capacity(64) {
+  // Round up to a power of two so slot indexes are a simple mask
+  while (this->capacity < capacity) {
+    this->capacity <<= 1;
+  }
+}
+
+ShmRingProducer::~ShmRingProducer() {
+  stop();
+  if (header) {
+    munmap(header, mapped_size);
+  }
+  if (fd >= 0) {
+    close(fd);  // Also releases the producer lock; the ring file stays
+  }
+}
+
+bool ShmRingProducer::start() {
+  if (generator.kind() != IdKind::INT64) {
+    cerr << "Shared-memory ring only supports 64-bit ID generators" << endl;
+    return false;
+  }
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    perror("Failed to open shared-memory ring");
+    return false;
+  }
+
+  if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+    cerr << "Shared-memory ring " << path
+         << " is owned by another running producer" << endl;
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  if (!attach_existing() && !create_fresh()) {
+    return false;
+  }
+
+  is_running = true;
+  refill_thread = thread(&ShmRingProducer::refill_loop, this);
+  return true;
+}
+
+void ShmRingProducer::stop() {
+  if (!is_running.exchange(false)) {
+    return;
+  }
+  header->space_seq.fetch_add(1);
+  shm_futex_wake_all(&header->space_seq);
+  if (refill_thread.joinable()) {
+    refill_thread.join();
+  }
+}
+
+bool ShmRingProducer::attach_existing() {
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      static_cast<size_t>(st.st_size) != shm_ring_file_size(capacity, slot_words)) {
+    return false;
+  }
+
+  void* p =
+      mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+
+  ShmRingHeader* existing = static_cast<ShmRingHeader*>(p);
+  if (existing->magic.load(memory_order_acquire) != SHM_RING_MAGIC ||
+      existing->version != SHM_RING_VERSION ||
+      existing->capacity != capacity || existing->slot_words != slot_words ||
+      existing->closed.load()) {
+    munmap(p, st.st_size);
+    return false;
+  }
+
+  // Continue from the previous producer's tail. IDs it already published
+  // are still unique and are left for consumers to claim.
+  header = existing;
+  slots = reinterpret_cast<atomic<uint64_t>*>(static_cast<char*>(p) +
+                                              SHM_RING_SLOTS_OFFSET);
+  mapped_size = st.st_size;
+  header->producer_sleeping.store(0);
+
+  cout << "Re-attached to shared-memory ring " << path << " with "
+       << header->tail.load() - header->head.load() << " unclaimed IDs"
+       << endl;
+  return true;
+}
+
+bool ShmRingProducer::create_fresh() {
+  // Retire an incompatible ring instead of reinitialising it in place, so a
+  // consumer mid-CAS can never see head/tail values repeat
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= SHM_RING_SLOTS_OFFSET) {
+    void* p = mmap(nullptr, SHM_RING_SLOTS_OFFSET, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      ShmRingHeader* old = static_cast<ShmRingHeader*>(p);
+      if (old->magic.load() == SHM_RING_MAGIC) {
+        old->closed.store(1);
+        old->data_seq.fetch_add(1);
+        shm_futex_wake_all(&old->data_seq);
+      }
+      munmap(p, SHM_RING_SLOTS_OFFSET);
+    }
+  }
+
+  string tmp_path = path + ".tmp." + to_string(getpid());
+  int new_fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                    0666);
+  if (new_fd < 0) {
+    perror("Failed to create shared-memory ring");
+    return false;
+  }
+  fchmod(new_fd, 0666);  // The app container usually runs as another user
+
+  size_t size = shm_ring_file_size(capacity, slot_words);
+  if (ftruncate(new_fd, size) < 0 || flock(new_fd, LOCK_EX | LOCK_NB) < 0) {
+    perror("Failed to size shared-memory ring");
+    close(new_fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+  if (p == MAP_FAILED) {
+    perror("Failed to map shared-memory ring");
+    close(new_fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  // The file starts zero-filled, so every counter already reads 0
+  header = static_cast<ShmRingHeader*>(p);
+  header->version = SHM_RING_VERSION;
+  header->slot_words = slot_words;
+  header->capacity = capacity;
+  header->magic.store(SHM_RING_MAGIC, memory_order_release);
+  slots = reinterpret_cast<atomic<uint64_t>*>(static_cast<char*>(p) +
+                                              SHM_RING_SLOTS_OFFSET);
+  mapped_size = size;
+
+  // Atomically replace whatever was at `path`
+  if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+    perror("Failed to publish shared-memory ring");
+    munmap(p, size);
+    header = nullptr;
+    close(new_fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  close(fd);
+  fd = new_fd;
+
+  cout << "Created shared-memory ring " << path << " with " << capacity
+       << " slots" << endl;
+  return true;
+}
+
+size_t ShmRingProducer::generate(uint64_t* out, size_t n) {
+  size_t produced = 0;
+  try {
+    // A short batch means the generator failed; never publish a 0 ID
+    produced = generator.next_ids(out, n);
+  } catch (const exception& e) {
+    cerr << "Shared-memory ring refill failed: " << e.what() << endl;
+  }
+  return produced;
+}
+
+void ShmRingProducer::refill_loop() {
+  const uint64_t mask = capacity - 1;
+  uint64_t buffer[REFILL_CHUNK];
+
+  while (is_running) {
+    uint64_t t = header->tail.load(memory_order_relaxed);
+    uint64_t h = header->head.load(memory_order_acquire);
+    uint64_t free_slots = capacity - (t - h);
+
+    if (free_slots == 0) {
+      // Full: sleep until consumers drain the ring to half
+      uint32_t seq = header->space_seq.load();
+      header->producer_sleeping.store(1);
+      if (t - header->head.load() > capacity / 2 && is_running) {
+        shm_futex_wait(&header->space_seq, seq, 100);
+      }
+      header->producer_sleeping.store(0);
+      continue;
+    }
+
+    size_t n = generate(buffer, min<uint64_t>(free_slots, REFILL_CHUNK));
+    if (n == 0) {
+      this_thread::sleep_for(chrono::milliseconds(10));
+      continue;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      slots[(t + i) & mask].store(buffer[i], memory_order_relaxed);
+    }
+    // Publishing tail makes the slots visible to consumers
+    header->tail.store(t + n);
+
+    header->data_seq.fetch_add(1);
+    if (header->sleeping_consumers.load() > 0) {
+      shm_futex_wake_all(&header->data_seq);
+    }
+  }
+}
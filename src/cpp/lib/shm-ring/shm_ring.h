@@ -0,0 +1,258 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+class IdGenerator;
+
+/**
+ * Shared-memory ID ring between the sidecar (single producer) and any
+ * number of app processes/threads (consumers).
+ *
+ * The ring is a file, normally in a memory-backed emptyDir shared by the
+ * pod's containers. It holds a header followed by `capacity` slots of
+ * `slot_words` 64-bit words each. `head` and `tail` are 64-bit counters
+ * that only ever grow; slot i lives at index (i & (capacity - 1)).
+ *
+ * - The producer writes slots [tail, head + capacity) and then publishes
+ *   them with a release store to `tail`.
+ * - A consumer reads slot `head` and claims it with a CAS head -> head + 1.
+ *   The read is only kept if the CAS succeeds, which also proves the
+ *   producer had not yet reused the slot.
+ * - Empty consumers sleep on the `data_seq` futex; the producer sleeps on
+ *   `space_seq` once the ring is full and is woken when it drains to half.
+ *
+ * Crash-safety rules (an ID is never handed out twice):
+ * - A claimed ID belongs to the claiming consumer even if it then crashes;
+ *   the worst case is a gap, never a duplicate.
+ * - A restarted producer re-attaches to a compatible ring and continues
+ *   from `tail`. It never resets `head`/`tail`, so no consumer CAS can
+ *   succeed against a recycled counter value (no ABA).
+ * - An incompatible ring is never reinitialised in place. The producer
+ *   marks it `closed`, and publishes a fresh file under the same path via
+ *   rename(); consumers seeing `closed` re-open the path.
+ * - Only one producer may own a ring: it holds flock(LOCK_EX) on the file,
+ *   which the kernel drops automatically if the producer dies.
+ * - Slots become visible only through the `tail` store, so a producer that
+ *   dies mid-refill leaves no half-written ID behind.
+ */
+
+const uint64_t SHM_RING_MAGIC = 0x474e495244495555ULL;  // "UUIDRING"
+const uint32_t SHM_RING_VERSION = 1;
+
+struct ShmRingHeader {
+  std::atomic<uint64_t> magic;  // Stored last when the ring is created
+  uint32_t version;
+  uint32_t slot_words;  // 1 for 64-bit IDs, 2 for 128-bit IDs
+  uint64_t capacity;    // Power of two
+  std::atomic<uint32_t> closed;  // Set when the producer replaces the ring
+
+  alignas(64) std::atomic<uint64_t> head;  // Next slot to claim
+  alignas(64) std::atomic<uint64_t> tail;  // Next slot to publish
+
+  // Consumers wait here for data
+  alignas(64) std::atomic<uint32_t> data_seq;
+  std::atomic<uint32_t> sleeping_consumers;
+
+  // The producer waits here for free space
+  alignas(64) std::atomic<uint32_t> space_seq;
+  std::atomic<uint32_t> producer_sleeping;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free");
+
+// Slots start on their own cache line after the header
+const size_t SHM_RING_SLOTS_OFFSET = (sizeof(ShmRingHeader) + 63) & ~size_t(63);
+
+inline size_t shm_ring_file_size(uint64_t capacity, uint32_t slot_words) {
+  return SHM_RING_SLOTS_OFFSET + capacity * slot_words * sizeof(uint64_t);
+}
+
+// Shared (not FUTEX_PRIVATE) futex operations, usable across processes
+inline void shm_futex_wait(std::atomic<uint32_t>* word, uint32_t expected,
+                           int timeout_ms) {
+  struct timespec ts;
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+          &ts, nullptr, 0);
+}
+
+inline void shm_futex_wake_all(std::atomic<uint32_t>* word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+/**
+ * App-side view of the ring. Each consumer process opens the ring once;
+ * pop() is safe to call from any number of threads.
+ */
+class ShmRingConsumer {
+ private:
+  std::string path;
+  ShmRingHeader* header = nullptr;
+  std::atomic<uint64_t>* slots = nullptr;
+  size_t mapped_size = 0;
+
+  void unmap() {
+    if (header) {
+      munmap(header, mapped_size);
+      header = nullptr;
+      slots = nullptr;
+    }
+  }
+
+ public:
+  explicit ShmRingConsumer(const std::string& path) : path(path) {}
+  ~ShmRingConsumer() { unmap(); }
+  ShmRingConsumer(const ShmRingConsumer&) = delete;
+  ShmRingConsumer& operator=(const ShmRingConsumer&) = delete;
+
+  // Maps the ring. Returns false if the producer has not created it yet.
+  // Not thread-safe: call before sharing the consumer between threads.
+  bool open() {
+    unmap();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        static_cast<size_t>(st.st_size) < SHM_RING_SLOTS_OFFSET) {
+      close(fd);
+      return false;
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+
+    header = static_cast<ShmRingHeader*>(p);
+    mapped_size = st.st_size;
+    if (header->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC ||
+        header->version != SHM_RING_VERSION ||
+        shm_ring_file_size(header->capacity, header->slot_words) >
+            mapped_size) {
+      unmap();
+      return false;
+    }
+
+    slots = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(p) +
+                                                     SHM_RING_SLOTS_OFFSET);
+    return true;
+  }
+
+  bool is_open() const { return header != nullptr; }
+
+  // True once the producer has replaced this ring; call open() again
+  bool is_closed() const {
+    return header && header->closed.load(std::memory_order_acquire);
+  }
+
+  uint32_t slot_words() const { return header ? header->slot_words : 0; }
+
+  /**
+   * Claims the next ID, writing slot_words() words to `out`. Sleeps on the
+   * futex for up to `timeout_ms` while the ring is empty.
+   *
+   * @return false on timeout or if the ring was closed by the producer.
+   */
+  bool pop(uint64_t* out, int timeout_ms) {
+    if (!header) return false;
+
+    const uint64_t mask = header->capacity - 1;
+    const uint32_t words = header->slot_words;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (true) {
+      uint64_t h = header->head.load(std::memory_order_acquire);
+      uint64_t t = header->tail.load(std::memory_order_acquire);
+
+      if (h < t) {
+        std::atomic<uint64_t>* slot = slots + (h & mask) * words;
+        for (uint32_t w = 0; w < words; ++w) {
+          out[w] = slot[w].load(std::memory_order_relaxed);
+        }
+        // The read only counts if nobody (consumer or producer) moved past h
+        if (header->head.compare_exchange_weak(h, h + 1,
+                                               std::memory_order_acq_rel)) {
+          if (t - (h + 1) <= header->capacity / 2 &&
+              header->producer_sleeping.load()) {
+            header->space_seq.fetch_add(1);
+            shm_futex_wake_all(&header->space_seq);
+          }
+          return true;
+        }
+        continue;
+      }
+
+      if (header->closed.load(std::memory_order_acquire)) return false;
+
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                        (now.tv_nsec - start.tv_nsec) / 1000000;
+      if (elapsed_ms >= timeout_ms) return false;
+
+      // Register as a sleeper, then re-check so a publish between the
+      // emptiness check and the wait cannot be missed
+      uint32_t seq = header->data_seq.load();
+      header->sleeping_consumers.fetch_add(1);
+      if (header->tail.load() == t) {
+        shm_futex_wait(&header->data_seq, seq, timeout_ms - elapsed_ms);
+      }
+      header->sleeping_consumers.fetch_sub(1);
+    }
+  }
+};
+
+/**
+ * Sidecar-side owner of the ring. A background thread keeps the ring full
+ * from the active IdGenerator.
+ */
+class ShmRingProducer {
+ private:
+  IdGenerator& generator;
+  std::string path;
+  uint64_t capacity;
+  uint32_t slot_words = 1;
+
+  int fd = -1;
+  ShmRingHeader* header = nullptr;
+  std::atomic<uint64_t>* slots = nullptr;
+  size_t mapped_size = 0;
+
+  std::thread refill_thread;
+  std::atomic<bool> is_running{false};
+
+  bool attach_existing();
+  bool create_fresh();
+  void refill_loop();
+  size_t generate(uint64_t* out, size_t n);
+
+ public:
+  ShmRingProducer(IdGenerator& generator, const std::string& path,
+                  uint64_t capacity);
+  ~ShmRingProducer();
+
+  // Creates or re-attaches to the ring and starts the refill thread
+  bool start();
+  void stop();
+};
+
+#endif  // SHM_RING_H
@@ -0,0 +1,16 @@
+#include "snowflake.h"
+
+#include "../network_util.h"
+
+Snowflake::Snowflake(uint64_t slice_index, uint64_t slice_count)
+    : stripes(get_node_ids_from_ip(StandardLayout::MAX_NODE,
+                                   node_id_stripes(StandardLayout::MAX_NODE)),
+              SequenceSlice::of(StandardLayout::SEQUENCE_BITS, slice_index,
+                                slice_count),
+              "snowflake") {}
+
+uint64_t Snowflake::next_id() { return stripes.next_id(); }
+
+size_t Snowflake::next_ids(uint64_t* out, size_t n) {
+  return stripes.next_ids(out, n);
+}
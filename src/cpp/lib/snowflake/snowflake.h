@@ -0,0 +1,31 @@
+#ifndef SNOWFLAKE_H
+#define SNOWFLAKE_H
+
+#include <cstdint>
+
+#include "../id_generator.h"
+#include "../snowflake_layout.h"
+#include "snowflake_stripes.h"
+
+/**
+ * Standard Twitter Snowflake: [41 bits time (ms)] - [10 bits node] -
+ * [12 bits sequence], with the node ID derived from the pod's IP.
+ *
+ * By default it uses a strict physical clock: if the clock moves backwards
+ * it refuses to generate IDs (next_id() returns 0) instead of risking
+ * duplicates (see SnowflakeEngine for CLOCK_MAX_SKEW_MS).
+ */
+class Snowflake : public IdGenerator {
+ private:
+  SnowflakeStripes<StandardLayout> stripes;
+
+ public:
+  // slice_index/slice_count give this instance its own part of the sequence
+  // space when several instances share a node ID (one per worker thread).
+  // NODE_ID_STRIPES sets how many node IDs the instance owns.
+  explicit Snowflake(uint64_t slice_index = 0, uint64_t slice_count = 1);
+  uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
+};
+
+#endif  // SNOWFLAKE_H
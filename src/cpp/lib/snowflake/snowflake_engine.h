@@ -0,0 +1,253 @@
+#ifndef SNOWFLAKE_ENGINE_H
+#define SNOWFLAKE_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include "../checkpoint/timestamp_checkpoint.h"
+#include "../clock/clock_source.h"
+#include "../id_generator.h"
+#include "../metrics/metrics.h"
+#include "../snowflake_layout.h"
+#include "tick_waiter.h"
+
+/**
+ * Lock-free Snowflake sequencing for any SnowflakeLayout.
+ *
+ * The last issued tick and sequence number live in one packed 64-bit
+ * atomic, [tick][sequence], advanced with a single CAS. No two callers can
+ * observe the same (tick, sequence) pair, so IDs never repeat. The atomic
+ * sits alone on its cache line: it is the only field written on the hot
+ * path, and neighbouring objects must not false-share with it.
+ *
+ * When a tick's sequence numbers run out, callers wait for the next tick in
+ * a TickWaiter.
+ *
+ * By default clock handling is strict: if the clock is behind the last
+ * issued tick, generation fails (next_id() returns 0) until it catches up.
+ * With CLOCK_MAX_SKEW_MS set, the engine rides through a clock step
+ * backwards of up to that many milliseconds, like HlcSnowflake: it keeps
+ * issuing from the last tick and, once that runs out, borrows the next
+ * tick instead of waiting for the clock to pass it. IDs stay unique and
+ * increasing; their time field runs ahead of the clock by at most the
+ * budget, which is exported as id_generator_clock_skew_milliseconds.
+ *
+ * With a process checkpoint open (CHECKPOINT_PATH), the engine starts after
+ * the restored floor and reports its last issued tick to the checkpoint.
+ */
+template <typename Layout>
+class alignas(64) SnowflakeEngine {
+ private:
+  alignas(64) std::atomic<uint64_t> state{0};
+
+  alignas(64) uint64_t node_id;
+  SequenceSlice sequence_slice;
+  ClockSource& clock;
+  uint64_t max_skew_ticks;  // How far ahead of the clock we may run; 0: strict
+  Counter& cas_retries;
+  Counter& sequence_exhausted;
+  Counter& clock_backwards;
+  Gauge& clock_skew;
+  TickWaiter waiter;
+  TimestampCheckpoint* checkpoint;
+  uint64_t checkpoint_source = 0;
+
+  uint64_t current_tick() { return Layout::to_ticks(clock.now_millis()); }
+
+  void report_clock_backwards() {
+    clock_backwards.inc();
+    std::cerr << "Clock moved backwards. Refusing to generate id."
+              << std::endl;
+  }
+
+  static uint64_t max_skew_ticks_from_env() {
+    const char* value = getenv("CLOCK_MAX_SKEW_MS");
+    return value ? strtoull(value, nullptr, 10) / Layout::TICK_MILLIS : 0;
+  }
+
+  // Only maintained in tolerant mode; the gauge is written when it changes
+  void record_skew(uint64_t tick, uint64_t now) {
+    int64_t skew = tick > now ? (tick - now) * Layout::TICK_MILLIS : 0;
+    if (clock_skew.get() != skew) {
+      clock_skew.set(skew);
+    }
+  }
+
+  /**
+   * Claims up to `count` consecutive sequence numbers of one tick with a
+   * single successful CAS.
+   *
+   * @param wait Whether to wait for the next tick when this one is used up
+   * @return How many were claimed, starting at *seq_out in tick *tick_out;
+   * 0 if the clock moved back further than the skew budget, or if the tick
+   * is used up and `wait` is false (then the next tick is not borrowed
+   * either).
+   */
+  uint64_t reserve(uint64_t count, uint64_t* tick_out, uint64_t* seq_out,
+                   bool wait = true) {
+    uint64_t current = state.load(std::memory_order_relaxed);
+    uint64_t now = current_tick();
+    uint64_t attempts = 0;
+
+    while (true) {
+      ++attempts;
+      uint64_t last_tick = current >> Layout::SEQUENCE_BITS;
+      uint64_t last_seq = current & Layout::MAX_SEQUENCE;
+      uint64_t tick;
+      uint64_t first_seq;
+
+      if (now < last_tick) {
+        // Another caller may simply have read a newer clock; re-read before
+        // treating this as a regression
+        now = current_tick();
+      }
+
+      if (now > last_tick) {
+        // New tick: restart the sequence
+        tick = now;
+        first_seq = 0;
+      } else if (last_tick - now > max_skew_ticks) {
+        report_clock_backwards();
+        return 0;
+      } else if (last_seq >= sequence_slice.mask) {
+        // This tick's sequence numbers (or this instance's slice) are used up
+        sequence_exhausted.inc();
+        if (!wait) {
+          // Checked first: a caller with other stripes to try should use
+          // them before spending the skew budget
+          return 0;
+        } else if (now < last_tick && last_tick + 1 - now <= max_skew_ticks) {
+          // Behind the clock, within the budget: borrow the next tick
+          tick = last_tick + 1;
+          first_seq = 0;
+        } else {
+          uint64_t passed = waiter.wait_past(now);
+          if (passed == 0 && max_skew_ticks == 0) {
+            report_clock_backwards();
+            return 0;
+          }
+          // A further step back is judged against the budget above
+          now = passed != 0 ? passed : current_tick();
+          current = state.load(std::memory_order_relaxed);
+          attempts = 0;  // Waiting is not a CAS retry
+          continue;
+        }
+      } else {
+        tick = last_tick;
+        first_seq = last_seq + 1;
+      }
+
+      uint64_t reserved = sequence_slice.mask - first_seq + 1;
+      if (reserved > count) {
+        reserved = count;
+      }
+      uint64_t next =
+          (tick << Layout::SEQUENCE_BITS) | (first_seq + reserved - 1);
+
+      if (state.compare_exchange_weak(current, next,
+                                      std::memory_order_relaxed)) {
+        if (attempts > 1) {
+          cas_retries.inc(attempts - 1);
+        }
+        if (max_skew_ticks > 0) {
+          record_skew(tick, now);
+        }
+        *tick_out = tick;
+        *seq_out = first_seq;
+        return reserved;
+      }
+    }
+  }
+
+  // Starts after the checkpoint's floor and reports to it from now on
+  void restore_from(TimestampCheckpoint& restored) {
+    if (restored.floor_millis() > 0) {
+      // The floor's tick may hold IDs from before the restart: mark it used
+      uint64_t floor_tick = Layout::to_ticks(restored.floor_millis());
+      state.store((floor_tick << Layout::SEQUENCE_BITS) | Layout::MAX_SEQUENCE);
+    }
+    checkpoint_source = restored.add_source([this] {
+      uint64_t current = state.load(std::memory_order_relaxed);
+      if (current == 0) {
+        return static_cast<uint64_t>(0);
+      }
+      // Last millisecond of the last issued tick
+      return ((current >> Layout::SEQUENCE_BITS) + 1) * Layout::TICK_MILLIS -
+             1;
+    });
+  }
+
+  // next_ids() and try_next_ids()
+  size_t fill(uint64_t* out, size_t n, bool wait) {
+    size_t filled = 0;
+    while (filled < n) {
+      uint64_t tick;
+      uint64_t seq;
+      uint64_t reserved = reserve(n - filled, &tick, &seq, wait);
+      if (reserved == 0) {
+        break;
+      }
+      for (uint64_t i = 0; i < reserved; ++i) {
+        out[filled++] =
+            Layout::pack(tick, node_id, sequence_slice.base + seq + i);
+      }
+    }
+    return filled;
+  }
+
+ public:
+  /**
+   * @param node_id Value of the layout's node field
+   * @param sequence_slice Part of the sequence space this engine owns
+   * @param metrics_name `generator` label of the engine's counters
+   * @param clock Source of wall-clock time
+   */
+  SnowflakeEngine(uint64_t node_id, SequenceSlice sequence_slice,
+                  const char* metrics_name,
+                  ClockSource& clock = default_clock_source())
+      : node_id(node_id & Layout::MAX_NODE),
+        sequence_slice(sequence_slice),
+        clock(clock),
+        max_skew_ticks(max_skew_ticks_from_env()),
+        cas_retries(cas_retries_counter(metrics_name)),
+        sequence_exhausted(sequence_exhausted_counter(metrics_name)),
+        clock_backwards(clock_backwards_counter(metrics_name)),
+        clock_skew(clock_skew_gauge(metrics_name)),
+        waiter(clock, Layout::TICK_MILLIS, metrics_name),
+        checkpoint(process_checkpoint()) {
+    if (checkpoint) {
+      restore_from(*checkpoint);
+    }
+  }
+
+  ~SnowflakeEngine() {
+    if (checkpoint) {
+      checkpoint->remove_source(checkpoint_source);
+    }
+  }
+
+  SnowflakeEngine(const SnowflakeEngine&) = delete;
+  SnowflakeEngine& operator=(const SnowflakeEngine&) = delete;
+
+  uint64_t next_id() {
+    uint64_t tick;
+    uint64_t seq;
+    if (reserve(1, &tick, &seq) == 0) {
+      return 0;
+    }
+    return Layout::pack(tick, node_id, sequence_slice.base + seq);
+  }
+
+  // One CAS per tick the batch spans. Stops early if the clock regresses
+  // beyond the skew budget.
+  size_t next_ids(uint64_t* out, size_t n) { return fill(out, n, true); }
+
+  // Like next_ids(), but only takes what the current tick has left instead
+  // of waiting for the next one
+  size_t try_next_ids(uint64_t* out, size_t n) { return fill(out, n, false); }
+};
+
+#endif  // SNOWFLAKE_ENGINE_H
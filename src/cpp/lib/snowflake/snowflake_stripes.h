@@ -0,0 +1,107 @@
+#ifndef SNOWFLAKE_STRIPES_H
+#define SNOWFLAKE_STRIPES_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "snowflake_engine.h"
+
+/**
+ * Number of node IDs a Snowflake-style generator owns, from NODE_ID_STRIPES
+ * (default 1), capped at the layout's node space.
+ */
+inline uint64_t node_id_stripes(uint64_t max_node) {
+  const char* value = getenv("NODE_ID_STRIPES");
+  uint64_t stripes = value ? strtoull(value, nullptr, 10) : 1;
+  if (stripes < 1) {
+    return 1;
+  }
+  return stripes > max_node + 1 ? max_node + 1 : stripes;
+}
+
+/**
+ * One SnowflakeEngine per owned node ID, so a pod can issue K times the
+ * layout's per-node ceiling without changing the ID layout.
+ *
+ * Each thread gets a home stripe, round-robin on first use, so threads do
+ * not contend on one state word. A caller whose home stripe has used up
+ * the current tick takes what the other stripes have left in that tick,
+ * and only waits for the next tick once all of them are used up. Stripes
+ * share their metrics series.
+ *
+ * Ordering: IDs from one stripe still increase. Within a tick, IDs from
+ * different stripes are ordered by node ID (by sequence number for
+ * Sonyflake's layout), not by when they were issued, so one thread's IDs
+ * may decrease within a tick when it moves to another stripe. Across
+ * ticks, IDs still sort by time.
+ */
+template <typename Layout>
+class SnowflakeStripes {
+ private:
+  std::vector<std::unique_ptr<SnowflakeEngine<Layout>>> engines;
+
+  static size_t home_slot() {
+    static std::atomic<size_t> next_slot{0};
+    static thread_local size_t slot = next_slot.fetch_add(1);
+    return slot;
+  }
+
+ public:
+  /**
+   * @param node_ids One node ID per stripe (at least one)
+   * @param sequence_slice Part of the sequence space each stripe owns
+   * @param metrics_name `generator` label of the engines' counters
+   * @param clock Source of wall-clock time
+   */
+  SnowflakeStripes(const std::vector<uint64_t>& node_ids,
+                   SequenceSlice sequence_slice, const char* metrics_name,
+                   ClockSource& clock = default_clock_source()) {
+    for (uint64_t node_id : node_ids) {
+      engines.push_back(std::make_unique<SnowflakeEngine<Layout>>(
+          node_id, sequence_slice, metrics_name, clock));
+    }
+  }
+
+  size_t stripes() const { return engines.size(); }
+
+  uint64_t next_id() {
+    if (engines.size() == 1) {
+      return engines[0]->next_id();
+    }
+    uint64_t id;
+    return next_ids(&id, 1) == 1 ? id : 0;
+  }
+
+  // Stops early if the clock regresses beyond the skew budget
+  size_t next_ids(uint64_t* out, size_t n) {
+    if (engines.size() == 1) {
+      return engines[0]->next_ids(out, n);
+    }
+
+    size_t home = home_slot() % engines.size();
+    size_t filled = 0;
+    while (filled < n) {
+      // Take what every stripe has left in its current tick, home first
+      for (size_t i = 0; i < engines.size() && filled < n; ++i) {
+        SnowflakeEngine<Layout>& engine =
+            *engines[(home + i) % engines.size()];
+        filled += engine.try_next_ids(out + filled, n - filled);
+      }
+      // All used up: wait for the next tick on the home stripe
+      if (filled < n) {
+        size_t got = engines[home]->next_ids(out + filled, 1);
+        if (got == 0) {
+          break;
+        }
+        filled += got;
+      }
+    }
+    return filled;
+  }
+};
+
+#endif  // SNOWFLAKE_STRIPES_H
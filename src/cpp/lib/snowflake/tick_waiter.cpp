@@ -0,0 +1,124 @@
+#include "tick_waiter.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Spins before parking; each is one clock read plus a `pause` (~50 ns)
+static const uint32_t DEFAULT_SPINS = 200;
+
+// Shortest sleep, for clocks that lag CLOCK_REALTIME (COARSE, TICKER)
+static const uint64_t MIN_SLEEP_NS = 50000;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static TickWaiter::Strategy strategy_from_env() {
+  string type = getenv("SEQUENCE_WAIT") ? getenv("SEQUENCE_WAIT") : "HYBRID";
+  if (type == "SPIN") {
+    return TickWaiter::Strategy::SPIN;
+  }
+  if (type != "HYBRID") {
+    cerr << "Warning: unknown SEQUENCE_WAIT " << type << "; using HYBRID"
+         << endl;
+  }
+  return TickWaiter::Strategy::HYBRID;
+}
+
+TickWaiter::TickWaiter(ClockSource& clock, uint64_t tick_millis,
+                       const char* metrics_name)
+    : clock(clock),
+      tick_millis(tick_millis),
+      strategy(strategy_from_env()),
+      spins(getenv("SEQUENCE_WAIT_SPINS")
+                ? strtoul(getenv("SEQUENCE_WAIT_SPINS"), nullptr, 10)
+                : DEFAULT_SPINS),
+      wait_latency(sequence_wait_latency(metrics_name)) {}
+
+void TickWaiter::sleep_until(uint64_t tick) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t now_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+                    ts.tv_nsec;
+
+  // The clock source may lag CLOCK_REALTIME or not follow it at all
+  // (MANUAL), so keep the sleep between a short quantum and one tick
+  uint64_t wake_ns = tick * tick_millis * 1000000ULL;
+  if (wake_ns < now_ns + MIN_SLEEP_NS) {
+    wake_ns = now_ns + MIN_SLEEP_NS;
+  } else if (wake_ns > now_ns + tick_millis * 1000000ULL) {
+    wake_ns = now_ns + tick_millis * 1000000ULL;
+  }
+
+  struct timespec wake = {static_cast<time_t>(wake_ns / 1000000000),
+                          static_cast<long>(wake_ns % 1000000000)};
+  clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, nullptr);
+}
+
+void TickWaiter::park(uint32_t seen) {
+  // Bounded, in case the wake-up is missed; the caller re-checks the clock
+  uint64_t timeout_ms = tick_millis + 1;
+  struct timespec ts;
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+  parked.fetch_add(1);
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&generation),
+          FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+  parked.fetch_sub(1);
+}
+
+void TickWaiter::wake_parked() {
+  // Pairs with park(): a caller that registered after this bump sees the
+  // new generation and does not sleep
+  generation.fetch_add(1);
+  if (parked.load() > 0) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&generation),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+  }
+}
+
+uint64_t TickWaiter::wait_past(uint64_t last_tick) {
+  ScopedLatency timer(wait_latency);
+  uint32_t spun = 0;
+
+  while (true) {
+    uint32_t seen = generation.load();
+    uint64_t tick = current_tick();
+    if (tick > last_tick) {
+      return tick;
+    }
+    if (tick < last_tick) {
+      return 0;
+    }
+
+    if (strategy == Strategy::SPIN || spun < spins) {
+      ++spun;
+      cpu_relax();
+    } else if (!sleeper.exchange(true, memory_order_acquire)) {
+      // This caller sleeps for everyone and wakes them once the tick is over
+      uint64_t now = tick;
+      while (now == last_tick) {
+        sleep_until(last_tick + 1);
+        now = current_tick();
+      }
+      sleeper.store(false, memory_order_release);
+      wake_parked();
+    } else {
+      park(seen);
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef TICK_WAITER_H
+#define TICK_WAITER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "../clock/clock_source.h"
+#include "../metrics/metrics.h"
+
+/**
+ * Waits for the clock to leave a tick whose sequence numbers ran out.
+ *
+ * SEQUENCE_WAIT selects the strategy:
+ * - HYBRID (default): spin SEQUENCE_WAIT_SPINS times with `pause`, then
+ *   park. One parked caller sleeps with clock_nanosleep() until the next
+ *   tick boundary and wakes the others, which wait on a futex, all at once.
+ *   A Sonyflake burst (10 ms ticks) then costs no CPU while it waits.
+ * - SPIN: re-read the clock with `pause` until the tick changes. Lowest
+ *   wake-up latency, but every waiter burns a core.
+ *
+ * Every wait is recorded in id_generator_sequence_wait_duration_seconds.
+ */
+class TickWaiter {
+ public:
+  enum class Strategy { SPIN, HYBRID };
+
+ private:
+  // Bumped by the sleeping caller when the tick it slept for has begun
+  alignas(64) std::atomic<uint32_t> generation{0};
+  std::atomic<uint32_t> parked{0};
+  std::atomic<bool> sleeper{false};
+
+  alignas(64) ClockSource& clock;
+  uint64_t tick_millis;
+  Strategy strategy;
+  uint32_t spins;
+  LatencyHistogram& wait_latency;
+
+  uint64_t current_tick() { return clock.now_millis() / tick_millis; }
+  void sleep_until(uint64_t tick);
+  void park(uint32_t seen);
+  void wake_parked();
+
+ public:
+  /**
+   * @param clock Clock the ticks are read from
+   * @param tick_millis Length of a tick
+   * @param metrics_name `generator` label of the wait histogram
+   */
+  TickWaiter(ClockSource& clock, uint64_t tick_millis,
+             const char* metrics_name);
+
+  TickWaiter(const TickWaiter&) = delete;
+  TickWaiter& operator=(const TickWaiter&) = delete;
+
+  /**
+   * Blocks until the clock is past last_tick.
+   *
+   * @return The new tick, or 0 if the clock moved behind last_tick
+   */
+  uint64_t wait_past(uint64_t last_tick);
+};
+
+#endif  // TICK_WAITER_H
@@ -0,0 +1,98 @@
+#ifndef SNOWFLAKE_LAYOUT_H
+#define SNOWFLAKE_LAYOUT_H
+
+#include <cstdint>
+
+#include "id_generator.h"
+
+// Order of the node and sequence fields below the timestamp
+enum class FieldOrder {
+  TIME_NODE_SEQUENCE,  // Twitter Snowflake, Instagram
+  TIME_SEQUENCE_NODE,  // Sonyflake
+};
+
+/**
+ * Compile-time description of a 63-bit Snowflake-style ID:
+ * [1 bit unused] - [TimeBits time] - node and sequence in `Order`.
+ *
+ * Time is counted in ticks of TickMillis milliseconds since the shared
+ * EPOCH. All shifts and masks are constants, so pack() compiles down to two
+ * shifts and two ORs. New layouts (e.g. more sequence bits for a high-rate
+ * tier) are a new alias, not new code.
+ */
+template <uint64_t TimeBits, uint64_t NodeBits, uint64_t SequenceBits,
+          uint64_t TickMillis = 1,
+          FieldOrder Order = FieldOrder::TIME_NODE_SEQUENCE>
+struct SnowflakeLayout {
+  static_assert(TimeBits + NodeBits + SequenceBits == 63,
+                "Snowflake fields must fill the 63 bits below the sign bit");
+  static_assert(TimeBits > 0 && SequenceBits > 0,
+                "Snowflake IDs need a time and a sequence field");
+  static_assert(TickMillis > 0, "A tick must be at least 1 ms");
+
+  static constexpr uint64_t TIME_BITS = TimeBits;
+  static constexpr uint64_t NODE_BITS = NodeBits;
+  static constexpr uint64_t SEQUENCE_BITS = SequenceBits;
+  static constexpr uint64_t TICK_MILLIS = TickMillis;
+
+  static constexpr uint64_t MAX_TIME =
+      (static_cast<uint64_t>(1) << TimeBits) - 1;
+  static constexpr uint64_t MAX_NODE =
+      (static_cast<uint64_t>(1) << NodeBits) - 1;
+  static constexpr uint64_t MAX_SEQUENCE =
+      (static_cast<uint64_t>(1) << SequenceBits) - 1;
+
+  static constexpr uint64_t TIME_SHIFT = NodeBits + SequenceBits;
+  static constexpr uint64_t NODE_SHIFT =
+      Order == FieldOrder::TIME_NODE_SEQUENCE ? SequenceBits : 0;
+  static constexpr uint64_t SEQUENCE_SHIFT =
+      Order == FieldOrder::TIME_NODE_SEQUENCE ? 0 : NodeBits;
+
+  // EPOCH expressed in ticks
+  static constexpr uint64_t EPOCH_TICKS = EPOCH / TickMillis;
+
+  // Converts Unix milliseconds to the layout's absolute tick count
+  static constexpr uint64_t to_ticks(uint64_t unix_millis) {
+    return unix_millis / TickMillis;
+  }
+
+  // Packs an absolute tick count (see to_ticks), node ID and sequence
+  static constexpr uint64_t pack(uint64_t tick, uint64_t node,
+                                 uint64_t sequence) {
+    return ((tick - EPOCH_TICKS) << TIME_SHIFT) | (node << NODE_SHIFT) |
+           (sequence << SEQUENCE_SHIFT);
+  }
+
+  struct Fields {
+    uint64_t tick;  // Absolute, like the argument of pack()
+    uint64_t node;
+    uint64_t sequence;
+  };
+
+  static constexpr Fields unpack(uint64_t id) {
+    return {(id >> TIME_SHIFT) + EPOCH_TICKS, (id >> NODE_SHIFT) & MAX_NODE,
+            (id >> SEQUENCE_SHIFT) & MAX_SEQUENCE};
+  }
+};
+
+// [41 bits time (ms)] - [10 bits node] - [12 bits sequence]
+using StandardLayout = SnowflakeLayout<41, NODE_ID_BITS, SEQUENCE_BITS>;
+
+// [40 bits time (ms)] - [13 bits shard] - [10 bits sequence]. Instagram's
+// scheme has 41 time bits and no sign bit; the top one stays 0 until 2060,
+// so both produce the same IDs until then.
+using InstaLayout = SnowflakeLayout<40, 13, 10>;
+
+// [39 bits time (10 ms)] - [8 bits sequence] - [16 bits machine]
+using SonyLayout =
+    SnowflakeLayout<39, 16, 8, 10, FieldOrder::TIME_SEQUENCE_NODE>;
+
+static_assert(StandardLayout::TIME_SHIFT == TIMESTAMP_SHIFT &&
+                  StandardLayout::NODE_SHIFT == NODE_ID_SHIFT,
+              "StandardLayout must match the shared 64-bit parameters");
+static_assert(SonyLayout::unpack(SonyLayout::pack(SonyLayout::EPOCH_TICKS + 7,
+                                                  0xBEEF, 0x42))
+                      .node == 0xBEEF,
+              "pack() and unpack() must round-trip");
+
+#endif  // SNOWFLAKE_LAYOUT_H
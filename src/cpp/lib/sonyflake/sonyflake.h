@@ -1,40 +1,27 @@
 #ifndef SONYFLAKE_H
 #define SONYFLAKE_H
 
-#include <atomic>
 #include <cstdint>
 
+#include "../clock/clock_source.h"
 #include "../id_generator.h"
+#include "../snowflake/snowflake_stripes.h"
+#include "../snowflake_layout.h"
 
-// Sonyflake specific parameters
-const uint64_t SONY_TIME_BITS = 39;
-const uint64_t SONY_SEQUENCE_BITS = 8;
-const uint64_t SONY_MACHINE_ID_BITS = 16;
-
-const uint64_t MAX_SONY_SEQUENCE =
-    (static_cast<uint64_t>(1) << SONY_SEQUENCE_BITS) - 1;
-const uint64_t MAX_SONY_MACHINE_ID =
-    (static_cast<uint64_t>(1) << SONY_MACHINE_ID_BITS) - 1;
-
-const uint64_t SONY_MACHINE_ID_SHIFT = 0;
-const uint64_t SONY_SEQUENCE_SHIFT = SONY_MACHINE_ID_BITS;
-const uint64_t SONY_TIMESTAMP_SHIFT = SONY_SEQUENCE_BITS + SONY_MACHINE_ID_BITS;
-
-// Sonyflake uses 10ms units instead of 1ms
-const uint64_t SONY_EPOCH_10MS = EPOCH / 10;
-
+// Sonyflake layout: 10 ms ticks, 8-bit sequence, 16-bit machine ID (see
+// SonyLayout)
 class Sonyflake : public IdGenerator {
  private:
-  uint64_t machine_id;
-  std::atomic<uint64_t> sequence{0};
-  std::atomic<uint64_t> last_timestamp{0};
-
-  uint64_t current_time_10ms();
-  uint64_t wait_for_next_10ms(uint64_t last_ts);
+  SnowflakeStripes<SonyLayout> stripes;
 
  public:
-  Sonyflake();
+  // slice_index/slice_count give this instance its own part of the sequence
+  // space when several instances share a node ID (one per worker thread).
+  // NODE_ID_STRIPES sets how many node IDs the instance owns.
+  explicit Sonyflake(uint64_t slice_index = 0, uint64_t slice_count = 1,
+                     ClockSource& clock = default_clock_source());
   uint64_t next_id() override;
+  size_t next_ids(uint64_t* out, size_t n) override;
 };
 
 #endif  // SONYFLAKE_H
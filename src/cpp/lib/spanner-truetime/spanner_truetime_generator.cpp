@@ -18,7 +18,8 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
-SpannerTrueTimeGenerator::SpannerTrueTimeGenerator() {
+SpannerTrueTimeGenerator::SpannerTrueTimeGenerator()
+    : http_latency(backend_latency("spanner_truetime", "http_post")) {
   const char* spanner_host = getenv("SPANNER_EMULATOR_HOST")
                                  ? getenv("SPANNER_EMULATOR_HOST")
                                  : "spanner:9020";
@@ -50,6 +51,7 @@ string SpannerTrueTimeGenerator::http_post(const string& url,
   CURL* curl;
   CURLcode res;
   string readBuffer;
+  ScopedLatency timer(http_latency);
 
   curl = curl_easy_init();
   if (curl) {
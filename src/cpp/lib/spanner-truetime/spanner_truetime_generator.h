@@ -5,6 +5,7 @@
 #include <string>
 
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
 
 class SpannerTrueTimeGenerator : public IdGenerator {
  private:
@@ -15,6 +16,7 @@ class SpannerTrueTimeGenerator : public IdGenerator {
   std::string session_name;
   std::string shard_id;
   std::mutex mtx;
+  LatencyHistogram& http_latency;
 
   std::string http_post(const std::string& url, const std::string& data);
   void create_session();
@@ -24,6 +26,7 @@ class SpannerTrueTimeGenerator : public IdGenerator {
   ~SpannerTrueTimeGenerator();
   std::string next_id_string() override;
   uint64_t next_id() override { return 0; }  // Not used
+  IdKind kind() const override { return IdKind::TEXT; }
 };
 
 #endif  // SPANNER_TRUETIME_GENERATOR_H
@@ -16,7 +16,8 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
-SpannerGenerator::SpannerGenerator() {
+SpannerGenerator::SpannerGenerator()
+    : http_latency(backend_latency("spanner", "http_post")) {
   const char* spanner_host = getenv("SPANNER_EMULATOR_HOST")
                                  ? getenv("SPANNER_EMULATOR_HOST")
                                  : "spanner:9020";
@@ -43,6 +44,7 @@ string SpannerGenerator::http_post(const string& url, const string& data) {
   CURL* curl;
   CURLcode res;
   string readBuffer;
+  ScopedLatency timer(http_latency);
 
   curl = curl_easy_init();
   if (curl) {
@@ -6,6 +6,7 @@
 #include <string>
 
 #include "../id_generator.h"
+#include "../metrics/metrics.h"
 
 class SpannerGenerator : public IdGenerator {
  private:
@@ -15,6 +16,7 @@ class SpannerGenerator : public IdGenerator {
   std::string database_id;
   std::string session_name;
   std::mutex mtx;
+  LatencyHistogram& http_latency;
 
   std::string http_post(const std::string& url, const std::string& data);
   void create_session();
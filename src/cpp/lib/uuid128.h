@@ -0,0 +1,69 @@
+#ifndef UUID128_H
+#define UUID128_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/**
+ * A 128-bit UUID held by value.
+ *
+ * `hi` and `lo` are the first and last 8 bytes in RFC 4122 (big-endian)
+ * order, so comparing (hi, lo) orders UUIDv7s by time. Formatting is left
+ * to whoever needs text (see format/id_format.h): to_bytes() gives the
+ * BINARY(16) column form without ever building a string.
+ */
+struct Uuid128 {
+  uint64_t hi;
+  uint64_t lo;
+
+  // Length of the 8-4-4-4-12 text form
+  static const size_t TEXT_SIZE = 36;
+
+  bool is_nil() const { return hi == 0 && lo == 0; }
+
+  // Writes the 16 bytes in RFC 4122 order
+  void to_bytes(uint8_t* out) const {
+    for (int i = 0; i < 8; ++i) {
+      out[i] = static_cast<uint8_t>(hi >> (56 - 8 * i));
+      out[8 + i] = static_cast<uint8_t>(lo >> (56 - 8 * i));
+    }
+  }
+
+  // Parses an 8-4-4-4-12 hex UUID (either case)
+  static bool parse(const std::string& s, Uuid128* out) {
+    if (s.size() != TEXT_SIZE) {
+      return false;
+    }
+
+    uint64_t words[2] = {0, 0};
+    int nibbles = 0;
+    for (char c : s) {
+      if (c == '-') continue;
+      uint64_t v;
+      if (c >= '0' && c <= '9') {
+        v = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        v = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        v = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      if (nibbles >= 32) return false;
+      words[nibbles / 16] = (words[nibbles / 16] << 4) | v;
+      ++nibbles;
+    }
+
+    out->hi = words[0];
+    out->lo = words[1];
+    return nibbles == 32;
+  }
+};
+
+static_assert(std::is_trivially_copyable<Uuid128>::value,
+              "Uuid128 is passed around and stored as plain bytes");
+static_assert(sizeof(Uuid128) == 16, "Uuid128 must have no padding");
+
+#endif  // UUID128_H
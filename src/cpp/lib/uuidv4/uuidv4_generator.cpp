@@ -1,42 +1,43 @@
 #include "uuidv4_generator.h"
 
-#include <iomanip>
-#include <sstream>
-
 UuidV4Generator::UuidV4Generator() : gen(rd()) {}
 
-std::string UuidV4Generator::next_id_string() {
-  uint64_t part1;
-  uint64_t part2;
-
+size_t UuidV4Generator::next_ids128(Uuid128* out, size_t n) {
   {
     // Lock the generator to ensure thread safety for random generation
-    // std::mt19937_64 is not thread-safe by default
+    // std::mt19937_64 is not thread-safe by default. The whole batch is
+    // drawn under one acquisition.
     std::lock_guard<std::mutex> lock(mtx);
-    part1 = dis(gen);
-    part2 = dis(gen);
+    for (size_t i = 0; i < n; ++i) {
+      out[i].hi = dis(gen);
+      out[i].lo = dis(gen);
+    }
   }
 
-  // ---------------------------------------------------------
-  // Set Version (4) and Variant (RFC 4122) bits
-  // ---------------------------------------------------------
+  for (size_t i = 0; i < n; ++i) {
+    // ---------------------------------------------------------
+    // Set Version (4) and Variant (RFC 4122) bits
+    // ---------------------------------------------------------
+
+    // Set version to 4 in hi (the 13th hex character)
+    // hi layout: [32 bits] - [16 bits] - [16 bits (version + 12 bits)]
+    out[i].hi = (out[i].hi & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
 
-  // Set version to 4 in part1 (the 13th hex character)
-  // part1 layout: [32 bits] - [16 bits] - [16 bits (version + 12 bits)]
-  part1 = (part1 & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+    // Set variant to 10xx in lo (the 17th hex character)
+    // lo layout: [16 bits (variant + 12 bits)] - [48 bits]
+    out[i].lo = (out[i].lo & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+  }
 
-  // Set variant to 10xx in part2 (the 17th hex character)
-  // part2 layout: [16 bits (variant + 12 bits)] - [48 bits]
-  part2 = (part2 & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+  return n;
+}
 
-  // ---------------------------------------------------------
-  // Format as 8-4-4-4-12 hex string
-  // ---------------------------------------------------------
-  std::stringstream ss;
-  ss << std::hex << std::setfill('0') << std::setw(8) << (part1 >> 32) << "-"
-     << std::setw(4) << ((part1 >> 16) & 0xFFFF) << "-" << std::setw(4)
-     << (part1 & 0xFFFF) << "-" << std::setw(4) << (part2 >> 48) << "-"
-     << std::setw(12) << (part2 & 0xFFFFFFFFFFFFULL);
+Uuid128 UuidV4Generator::next_id128() {
+  Uuid128 id;
+  next_ids128(&id, 1);
+  return id;
+}
 
-  return ss.str();
+std::string UuidV4Generator::next_id_string() {
+  // Text is only built for callers that ask for it
+  return uuid_to_string(next_id128());
 }
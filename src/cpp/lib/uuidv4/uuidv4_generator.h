@@ -17,6 +17,9 @@ class UuidV4Generator : public IdGenerator {
  public:
   UuidV4Generator();
   std::string next_id_string() override;
+  Uuid128 next_id128() override;
+  size_t next_ids128(Uuid128* out, size_t n) override;
+  IdKind kind() const override { return IdKind::UUID128; }
 };
 
 #endif  // UUIDV4_GENERATOR_H
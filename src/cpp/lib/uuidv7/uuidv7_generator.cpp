@@ -1,28 +1,20 @@
 #include "uuidv7_generator.h"
 
-#include <chrono>
-#include <iomanip>
-#include <sstream>
+UuidV7Generator::UuidV7Generator(ClockSource& clock)
+    : gen(rd()), clock(clock) {}
 
-UuidV7Generator::UuidV7Generator() : gen(rd()) {}
-
-uint64_t UuidV7Generator::current_time_millis() {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(
-             std::chrono::system_clock::now().time_since_epoch())
-      .count();
-}
-
-std::string UuidV7Generator::next_id_string() {
-  uint64_t timestamp = current_time_millis();
-  uint64_t rand_a;
-  uint64_t rand_b;
+size_t UuidV7Generator::next_ids128(Uuid128* out, size_t n) {
+  uint64_t timestamp = clock.now_millis();
 
   {
     // Lock the generator to ensure thread safety for random generation
-    // std::mt19937_64 is not thread-safe by default
+    // std::mt19937_64 is not thread-safe by default. The whole batch is
+    // drawn under one acquisition.
     std::lock_guard<std::mutex> lock(mtx);
-    rand_a = dis(gen);
-    rand_b = dis(gen);
+    for (size_t i = 0; i < n; ++i) {
+      out[i].hi = dis(gen);
+      out[i].lo = dis(gen);
+    }
   }
 
   // ---------------------------------------------------------
@@ -34,21 +26,24 @@ std::string UuidV7Generator::next_id_string() {
   // rand_a: 12 bits
   // var: 2 bits (10)
   // rand_b: 62 bits
+  for (size_t i = 0; i < n; ++i) {
+    // hi contains: unix_ts_ms (48 bits) | ver (4 bits) | rand_a (12 bits)
+    out[i].hi = (timestamp << 16) | 0x7000ULL | (out[i].hi & 0x0FFFULL);
 
-  // part1 contains: unix_ts_ms (48 bits) | ver (4 bits) | rand_a (12 bits)
-  uint64_t part1 = (timestamp << 16) | 0x7000ULL | (rand_a & 0x0FFFULL);
+    // lo contains: var (2 bits) | rand_b (62 bits)
+    out[i].lo = 0x8000000000000000ULL | (out[i].lo & 0x3FFFFFFFFFFFFFFFULL);
+  }
 
-  // part2 contains: var (2 bits) | rand_b (62 bits)
-  uint64_t part2 = 0x8000000000000000ULL | (rand_b & 0x3FFFFFFFFFFFFFFFULL);
+  return n;
+}
 
-  // ---------------------------------------------------------
-  // Format as 8-4-4-4-12 hex string
-  // ---------------------------------------------------------
-  std::stringstream ss;
-  ss << std::hex << std::setfill('0') << std::setw(8) << (part1 >> 32) << "-"
-     << std::setw(4) << ((part1 >> 16) & 0xFFFF) << "-" << std::setw(4)
-     << (part1 & 0xFFFF) << "-" << std::setw(4) << (part2 >> 48) << "-"
-     << std::setw(12) << (part2 & 0xFFFFFFFFFFFFULL);
+Uuid128 UuidV7Generator::next_id128() {
+  Uuid128 id;
+  next_ids128(&id, 1);
+  return id;
+}
 
-  return ss.str();
+std::string UuidV7Generator::next_id_string() {
+  // Text is only built for callers that ask for it
+  return uuid_to_string(next_id128());
 }
@@ -5,6 +5,7 @@
 #include <random>
 #include <string>
 
+#include "../clock/clock_source.h"
 #include "../id_generator.h"
 
 class UuidV7Generator : public IdGenerator {
@@ -13,12 +14,14 @@ class UuidV7Generator : public IdGenerator {
   std::mt19937_64 gen;
   std::uniform_int_distribution<uint64_t> dis;
   std::mutex mtx;
-
-  uint64_t current_time_millis();
+  ClockSource& clock;
 
  public:
-  UuidV7Generator();
+  explicit UuidV7Generator(ClockSource& clock = default_clock_source());
   std::string next_id_string() override;
+  Uuid128 next_id128() override;
+  size_t next_ids128(Uuid128* out, size_t n) override;
+  IdKind kind() const override { return IdKind::UUID128; }
 };
 
 #endif  // UUIDV7_GENERATOR_H
@@ -0,0 +1,89 @@
+// Runs TscClockSource next to CLOCK_REALTIME and fails if it drifts away
+// from it after re-anchoring, or if any thread sees it go backwards.
+//
+//   clock_drift_check [seconds]   (default 10)
+
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../lib/clock/clock_source.h"
+
+using namespace std;
+
+// Allowed distance from CLOCK_REALTIME once the first re-anchor (~1 s) has
+// corrected the startup calibration
+static const int64_t MAX_OFFSET_MS = 2;
+static const int64_t SETTLE_MS = 1500;
+static const int READERS = 4;
+
+static int64_t realtime_millis() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char** argv) {
+  int64_t duration_ms = (argc > 1 ? atoll(argv[1]) : 10) * 1000;
+
+  TscClockSource tsc;
+  if (!tsc.usable()) {
+    cout << "No invariant TSC; nothing to check" << endl;
+    return 0;
+  }
+
+  atomic<bool> is_running{true};
+  atomic<uint64_t> backwards{0};
+  vector<thread> readers;
+  for (int i = 0; i < READERS; ++i) {
+    readers.emplace_back([&] {
+      uint64_t last = 0;
+      while (is_running.load(memory_order_relaxed)) {
+        uint64_t now = tsc.now_millis();
+        if (now < last) {
+          backwards.fetch_add(1);
+        }
+        last = now;
+      }
+    });
+  }
+
+  int64_t start = realtime_millis();
+  int64_t worst = 0;
+  int64_t last_offset = 0;
+  while (realtime_millis() - start < duration_ms) {
+    this_thread::sleep_for(chrono::milliseconds(5));
+    // Bracket the TSC read, so preemption shows up as a wider window rather
+    // than as drift
+    int64_t before = realtime_millis();
+    int64_t millis = static_cast<int64_t>(tsc.now_millis());
+    int64_t after = realtime_millis();
+    int64_t offset = millis > after ? millis - after
+                     : millis < before ? millis - before
+                                       : 0;
+    last_offset = offset;
+    if (before - start >= SETTLE_MS && llabs(offset) > llabs(worst)) {
+      worst = offset;
+    }
+  }
+
+  is_running = false;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  cout << "TSC vs CLOCK_REALTIME over " << duration_ms / 1000
+       << " s: worst offset " << worst << " ms, last " << last_offset
+       << " ms; " << backwards.load() << " reads went backwards" << endl;
+  if (llabs(worst) > MAX_OFFSET_MS || backwards.load() > 0) {
+    cerr << "FAILED: the TSC clock drifted or moved backwards" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Measures the CPU time next_id() takes per thread as DualBufferGenerator is
+// shared by 1 to 64 threads, against the in-memory fake_mysql.cpp, and
+// fails if any ID is issued twice. Serving takes no lock, so the time per
+// ID should stay about flat as threads are added. Thread CPU time counts
+// contended cache lines and spinning but not waiting to be scheduled, so
+// this holds with more threads than cores.
+//
+//   dual_buffer_bench [ids_per_round]   (default 2000000)
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../lib/dual-buffer/dual_buffer.h"
+
+using namespace std;
+
+static const int THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+static const int ROUNDS = 3;  // Per thread count; the fastest is kept
+
+static double thread_cpu_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+struct Round {
+  double median_ns = 0;  // Of the threads' mean CPU time per ID
+  double slowest_ns = 0;
+  double ids_per_second = 0;
+  bool unique = true;
+};
+
+static Round run_round(DualBufferGenerator& generator, int threads,
+                       size_t total) {
+  size_t per_thread = total / threads;
+  vector<vector<uint64_t>> ids(threads, vector<uint64_t>(per_thread));
+  vector<double> ns_per_id(threads);
+
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      double begin = thread_cpu_ns();
+      for (uint64_t& id : ids[t]) {
+        id = generator.next_id();
+      }
+      ns_per_id[t] = (thread_cpu_ns() - begin) / per_thread;
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  vector<uint64_t> all;
+  all.reserve(per_thread * threads);
+  for (const auto& thread_ids : ids) {
+    all.insert(all.end(), thread_ids.begin(), thread_ids.end());
+  }
+  sort(all.begin(), all.end());
+
+  Round round;
+  round.unique = all.front() != 0 &&
+                 adjacent_find(all.begin(), all.end()) == all.end();
+  sort(ns_per_id.begin(), ns_per_id.end());
+  round.median_ns = ns_per_id[threads / 2];
+  round.slowest_ns = ns_per_id.back();
+  round.ids_per_second = all.size() / elapsed.count();
+  return round;
+}
+
+int main(int argc, char* argv[]) {
+  size_t total = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+
+  DualBufferGenerator generator;
+
+  // Let the step grow to what this rate needs, as it would in production
+  run_round(generator, 1, total);
+
+  printf("%7s %14s %14s %14s\n", "threads", "median cpu ns", "slowest cpu ns",
+         "total ids/s");
+  bool unique = true;
+  for (int threads : THREAD_COUNTS) {
+    Round best;
+    for (int r = 0; r < ROUNDS; ++r) {
+      Round round = run_round(generator, threads, total);
+      unique = unique && round.unique;
+      if (r == 0 || round.median_ns < best.median_ns) {
+        best = round;
+      }
+    }
+    printf("%7d %14.1f %14.1f %14.0f\n", threads, best.median_ns,
+           best.slowest_ns, best.ids_per_second);
+  }
+
+  if (!unique) {
+    cerr << "DualBufferGenerator issued an ID twice" << endl;
+    return 1;
+  }
+  cout << "No duplicate IDs" << endl;
+  return 0;
+}
@@ -0,0 +1,200 @@
+// An in-memory stand-in for the parts of libmysqlclient that MysqlPool and
+// DualBufferGenerator use, linked instead of -lmysqlclient so the generator
+// can be measured without a database. It holds one id_segments row per
+// biz_tag in FAKE_MYSQL_TAGS (default "default", step 1000), and every
+// statement sleeps FAKE_MYSQL_RTT_US (default 1000) like a round trip.
+
+#include <mysql/mysql.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+struct FakeConnection {};
+
+struct FakeStatement {
+  string sql;
+  MYSQL_BIND* params = nullptr;
+  MYSQL_BIND* result = nullptr;
+  uint64_t insert_id = 0;
+  uint64_t affected_rows = 0;
+  uint64_t step = 0;
+  bool has_row = false;
+};
+
+struct FakeResult {
+  char text[2] = "1";
+  char* row[1] = {text};
+  bool fetched = false;
+};
+
+struct Row {
+  uint64_t max_id = 0;
+  uint64_t step = 1000;
+};
+
+map<string, Row> initial_rows() {
+  map<string, Row> table;
+  const char* tags = getenv("FAKE_MYSQL_TAGS");
+  istringstream names(tags ? tags : "default");
+  string tag;
+  while (getline(names, tag, ',')) {
+    table[tag] = Row();
+  }
+  return table;
+}
+
+mutex table_mtx;
+map<string, Row> table = initial_rows();  // Guarded by table_mtx
+
+void round_trip() {
+  const char* rtt = getenv("FAKE_MYSQL_RTT_US");
+  this_thread::sleep_for(
+      chrono::microseconds(rtt ? strtoull(rtt, nullptr, 10) : 1000));
+}
+
+string bound_string(const MYSQL_BIND& param) {
+  return string(static_cast<const char*>(param.buffer), *param.length);
+}
+
+FakeStatement* statement(MYSQL_STMT* stmt) {
+  return reinterpret_cast<FakeStatement*>(stmt);
+}
+
+}  // namespace
+
+extern "C" {
+
+MYSQL* mysql_init(MYSQL*) {
+  return reinterpret_cast<MYSQL*>(new FakeConnection());
+}
+
+int mysql_options(MYSQL*, enum mysql_option, const void*) { return 0; }
+
+MYSQL* mysql_real_connect(MYSQL* mysql, const char*, const char*,
+                          const char*, const char*, unsigned int, const char*,
+                          unsigned long) {
+  return mysql;
+}
+
+void mysql_close(MYSQL* mysql) {
+  delete reinterpret_cast<FakeConnection*>(mysql);
+}
+
+const char* mysql_error(MYSQL*) { return "fake_mysql: unsupported"; }
+
+int mysql_get_socket(MYSQL*) { return -1; }
+
+int mysql_ping(MYSQL*) { return 0; }
+
+// Connection setup and SELECT @@auto_increment_increment
+int mysql_query(MYSQL*, const char*) { return 0; }
+
+MYSQL_RES* mysql_store_result(MYSQL*) {
+  return reinterpret_cast<MYSQL_RES*>(new FakeResult());
+}
+
+MYSQL_ROW mysql_fetch_row(MYSQL_RES* res) {
+  FakeResult* result = reinterpret_cast<FakeResult*>(res);
+  if (result->fetched) {
+    return nullptr;
+  }
+  result->fetched = true;
+  return result->row;
+}
+
+void mysql_free_result(MYSQL_RES* res) {
+  delete reinterpret_cast<FakeResult*>(res);
+}
+
+// Only the pipelined DB_AUTO_INC path sends raw queries
+enum net_async_status mysql_real_query_nonblocking(MYSQL*, const char*,
+                                                   unsigned long) {
+  return NET_ASYNC_ERROR;
+}
+
+my_ulonglong mysql_insert_id(MYSQL*) { return 0; }
+
+MYSQL_STMT* mysql_stmt_init(MYSQL*) {
+  return reinterpret_cast<MYSQL_STMT*>(new FakeStatement());
+}
+
+int mysql_stmt_prepare(MYSQL_STMT* stmt, const char* query,
+                       unsigned long length) {
+  statement(stmt)->sql.assign(query, length);
+  return 0;
+}
+
+bool mysql_stmt_bind_param(MYSQL_STMT* stmt, MYSQL_BIND* bind) {
+  statement(stmt)->params = bind;
+  return false;
+}
+
+bool mysql_stmt_bind_result(MYSQL_STMT* stmt, MYSQL_BIND* bind) {
+  statement(stmt)->result = bind;
+  return false;
+}
+
+// The generator's two statements: its UPDATE reserving a segment, and its
+// SELECT of the row's step
+int mysql_stmt_execute(MYSQL_STMT* stmt) {
+  FakeStatement* s = statement(stmt);
+  bool update = s->sql.compare(0, 6, "UPDATE") == 0;
+  string tag = bound_string(s->params[update ? 1 : 0]);
+  round_trip();
+
+  lock_guard<mutex> lock(table_mtx);
+  auto row = table.find(tag);
+  s->has_row = row != table.end();
+  s->affected_rows = s->has_row && update ? 1 : 0;
+  if (s->has_row) {
+    if (update) {
+      row->second.max_id += *static_cast<uint64_t*>(s->params[0].buffer);
+      s->insert_id = row->second.max_id;
+    }
+    s->step = row->second.step;
+  }
+  return 0;
+}
+
+int mysql_stmt_store_result(MYSQL_STMT*) { return 0; }
+
+int mysql_stmt_fetch(MYSQL_STMT* stmt) {
+  FakeStatement* s = statement(stmt);
+  if (!s->has_row) {
+    return MYSQL_NO_DATA;
+  }
+  s->has_row = false;
+  *static_cast<uint64_t*>(s->result[0].buffer) = s->step;
+  return 0;
+}
+
+bool mysql_stmt_free_result(MYSQL_STMT*) { return false; }
+
+bool mysql_stmt_close(MYSQL_STMT* stmt) {
+  delete statement(stmt);
+  return false;
+}
+
+my_ulonglong mysql_stmt_insert_id(MYSQL_STMT* stmt) {
+  return statement(stmt)->insert_id;
+}
+
+my_ulonglong mysql_stmt_affected_rows(MYSQL_STMT* stmt) {
+  return statement(stmt)->affected_rows;
+}
+
+const char* mysql_stmt_error(MYSQL_STMT*) {
+  return "fake_mysql: unsupported";
+}
+
+}  // extern "C"
@@ -0,0 +1,176 @@
+// Takes IDs from InstaSnowflake, Sonyflake and the engine stripes behind
+// EtcdSnowflake on many threads at once, on a ManualClockSource driven by a
+// separate thread, and fails if any ID is issued twice.
+//
+//   uniqueness_stress [ids_per_thread]   (default 50000)
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lib/clock/clock_source.h"
+#include "../lib/id_generator.h"
+#include "../lib/insta-snowflake/insta_snowflake.h"
+#include "../lib/snowflake/snowflake_stripes.h"
+#include "../lib/snowflake_layout.h"
+#include "../lib/sonyflake/sonyflake.h"
+
+using namespace std;
+
+static const int THREADS = 8;
+static const int INSTANCES = 2;  // Sharing node IDs through sequence slices
+static const size_t MAX_BATCH = 64;
+static const int STEP_BACK_EVERY = 2500;  // Clock updates (~250 ms)
+static const uint64_t STEP_BACK_MS = 3;
+
+static uint64_t wall_millis() {
+  return chrono::duration_cast<chrono::milliseconds>(
+             chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// EtcdSnowflake needs an etcd server to claim its node IDs; this is the
+// engine setup it builds once it has them
+class EtcdCore : public IdGenerator {
+ private:
+  SnowflakeStripes<StandardLayout> stripes;
+
+ public:
+  EtcdCore(uint64_t slice_index, uint64_t slice_count, ClockSource& clock)
+      : stripes(first_node_ids(node_id_stripes(StandardLayout::MAX_NODE)),
+                SequenceSlice::of(StandardLayout::SEQUENCE_BITS,
+                                  slice_index, slice_count),
+                "etcd_snowflake", clock) {}
+
+  static vector<uint64_t> first_node_ids(uint64_t count) {
+    vector<uint64_t> node_ids;
+    for (uint64_t i = 0; i < count; ++i) {
+      node_ids.push_back(i);
+    }
+    return node_ids;
+  }
+
+  uint64_t next_id() override { return stripes.next_id(); }
+  size_t next_ids(uint64_t* out, size_t n) override {
+    return stripes.next_ids(out, n);
+  }
+};
+
+using Factory =
+    function<unique_ptr<IdGenerator>(uint64_t, uint64_t, ClockSource&)>;
+
+// Returns false if an ID was issued twice
+static bool stress(const string& name, const Factory& create,
+                   size_t per_thread) {
+  ManualClockSource clock(wall_millis());
+
+  vector<unique_ptr<IdGenerator>> instances;
+  for (int i = 0; i < INSTANCES; ++i) {
+    instances.push_back(create(i, INSTANCES, clock));
+  }
+
+  // Follows the wall clock, so waiting callers sleep until the right tick,
+  // but steps back now and then, which callers must refuse to reuse
+  atomic<bool> is_running{true};
+  thread ticker([&] {
+    for (int update = 1; is_running.load(memory_order_relaxed); ++update) {
+      this_thread::sleep_for(chrono::microseconds(100));
+      uint64_t now = wall_millis();
+      clock.set_millis(update % STEP_BACK_EVERY == 0 ? now - STEP_BACK_MS
+                                                     : now);
+    }
+  });
+
+  vector<vector<uint64_t>> issued(THREADS);
+  vector<thread> threads;
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&, t] {
+      IdGenerator& generator = *instances[t % INSTANCES];
+      vector<uint64_t>& out = issued[t];
+      out.resize(per_thread);
+      size_t filled = 0;
+      size_t batch = 1;
+      while (filled < per_thread) {
+        // Mix single IDs and batches of every size
+        size_t n = min(batch, per_thread - filled);
+        if (n == 1) {
+          out[filled] = generator.next_id();
+          filled += out[filled] != 0 ? 1 : 0;
+        } else {
+          filled += generator.next_ids(out.data() + filled, n);
+        }
+        batch = batch % MAX_BATCH + 1;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  is_running = false;
+  ticker.join();
+
+  vector<uint64_t> all;
+  for (auto& ids : issued) {
+    all.insert(all.end(), ids.begin(), ids.end());
+  }
+  sort(all.begin(), all.end());
+  size_t duplicates = 0;
+  for (size_t i = 1; i < all.size(); ++i) {
+    if (all[i] == all[i - 1]) {
+      ++duplicates;
+    }
+  }
+
+  cout << name << ": " << all.size() << " IDs from " << THREADS
+       << " threads on " << INSTANCES << " instances in " << seconds
+       << " s, " << duplicates << " duplicates" << endl;
+  return duplicates == 0;
+}
+
+int main(int argc, char** argv) {
+  size_t per_thread = argc > 1 ? strtoull(argv[1], nullptr, 10) : 50000;
+
+  vector<pair<string, Factory>> generators = {
+      {"INSTA_SNOWFLAKE",
+       [](uint64_t slice, uint64_t slices, ClockSource& clock) {
+         return make_unique<InstaSnowflake>(slice, slices, clock);
+       }},
+      {"SONYFLAKE",
+       [](uint64_t slice, uint64_t slices, ClockSource& clock) {
+         return make_unique<Sonyflake>(slice, slices, clock);
+       }},
+      {"ETCD_SNOWFLAKE (engine stripes)",
+       [](uint64_t slice, uint64_t slices, ClockSource& clock) {
+         return make_unique<EtcdCore>(slice, slices, clock);
+       }},
+  };
+
+  bool ok = true;
+  // One node ID per instance, then several stripes sharing the load
+  for (const char* stripes : {"1", "4"}) {
+    setenv("NODE_ID_STRIPES", stripes, 1);
+    cout << "NODE_ID_STRIPES=" << stripes << endl;
+    for (auto& generator : generators) {
+      ok = stress("  " + generator.first, generator.second, per_thread) && ok;
+    }
+  }
+
+  if (!ok) {
+    cerr << "FAILED: IDs were issued more than once" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}